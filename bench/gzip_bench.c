@@ -0,0 +1,86 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "prime.h"
+#include "compress.h"
+
+// Costo de CPU vs. ahorro de ancho de banda de Content-Encoding: gzip sobre un
+// cuerpo /result tipico. Uso: ./gzip_bench [CANTIDAD] [DIGITOS] [REPETICIONES]
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Mismo orden que /result: numerico, (length(primo), primo)
+static int cmp_str(const void *a, const void *b) {
+    const char *x = *(char *const *)a, *y = *(char *const *)b;
+    size_t lx = strlen(x), ly = strlen(y);
+    if (lx != ly) return lx < ly ? -1 : 1;
+    return strcmp(x, y);
+}
+
+// Mismo generador que el worker: los primos guardados siempre caben en uint64.
+static char *random_prime_str(int digitos) {
+    uint64_t v;
+    do v = gen_random_of_digits(digitos); while (!is_probable_prime(v));
+    return u64_to_str(v);
+}
+
+int main(int argc, char **argv) {
+    int cantidad = argc > 1 ? atoi(argv[1]) : 1000;
+    int digitos = argc > 2 ? atoi(argv[2]) : 20;
+    int reps = argc > 3 ? atoi(argv[3]) : 200;
+    if (cantidad <= 0 || digitos <= 0 || reps <= 0) {
+        fprintf(stderr, "uso: %s [CANTIDAD] [DIGITOS] [REPETICIONES]\n", argv[0]);
+        return 1;
+    }
+
+    // Mismo cuerpo que arma serve_result(): primos ordenados como texto
+    char **primos = malloc(sizeof(char *) * cantidad);
+    for (int i = 0; i < cantidad; ++i) primos[i] = random_prime_str(digitos);
+    qsort(primos, cantidad, sizeof(char *), cmp_str);
+    size_t cap = 64 + (size_t)cantidad * (digitos + 3);
+    char *body = malloc(cap);
+    size_t len = (size_t)snprintf(body, cap, "{\"id\":\"00000000-0000-0000-0000-000000000000\",\"primos\":[");
+    for (int i = 0; i < cantidad; ++i) {
+        len += (size_t)snprintf(body + len, cap - len, "%s\"%s\"", i ? "," : "", primos[i]);
+    }
+    len += (size_t)snprintf(body + len, cap - len, "]}\n");
+
+    printf("cuerpo: %d primos de %d digitos, %zu bytes, %d repeticiones\n", cantidad, digitos, len, reps);
+    printf("%-6s %10s %7s %10s %9s %13s %13s %13s\n", "nivel", "bytes", "ratio", "us/cuerpo", "MB/s",
+        "10Mbit ms", "100Mbit ms", "1Gbit ms");
+    // Sin comprimir: solo transferencia
+    printf("%-6s %10zu %7.2f %10.1f %9s", "-", len, 1.0, 0.0, "-");
+    for (double mbit = 10; mbit <= 1000; mbit *= 10) printf(" %13.3f", len * 8 / (mbit * 1e3));
+    printf("\n");
+
+    int levels[] = { 1, 6, 9 };
+    for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); ++l) {
+        size_t gz_len = 0;
+        double t0 = now_s();
+        for (int r = 0; r < reps; ++r) {
+            char *gz;
+            if (gzip_compress(body, len, levels[l], &gz, &gz_len) != 0) {
+                fprintf(stderr, "gzip_compress fallo\n");
+                return 1;
+            }
+            free(gz);
+        }
+        double us = (now_s() - t0) / reps * 1e6;
+        // Tiempo total = CPU de compresion + transferencia del cuerpo comprimido
+        printf("%-6d %10zu %7.2f %10.1f %9.1f", levels[l], gz_len, (double)len / gz_len, us,
+            len / us);
+        for (double mbit = 10; mbit <= 1000; mbit *= 10) printf(" %13.3f", us / 1e3 + gz_len * 8 / (mbit * 1e3));
+        printf("\n");
+    }
+
+    for (int i = 0; i < cantidad; ++i) free(primos[i]);
+    free(primos);
+    free(body);
+    return 0;
+}
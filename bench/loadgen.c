@@ -0,0 +1,356 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Generador de carga HTTP para la API: HILOS hilos, cada uno con su conexion
+// keep-alive, disparando /new, /status y /result segun una mezcla. Con -r la
+// carga es de lazo abierto a tasa constante (estilo wrk2): cada peticion tiene
+// un instante de envio planificado y la latencia corregida se mide desde ese
+// instante, asi un servidor que se traba no esconde la cola que genero
+// (coordinated omission). Tambien se reporta el tiempo de servicio sin corregir.
+//
+// Uso: ./loadgen [-h host] [-p puerto] [-t hilos] [-r peticiones/s] [-d segundos]
+//                [-m new,status,result] [-n cantidad] [-g digitos]
+
+#define BUF_SIZE 65536
+#define MAX_IDS 256
+
+enum route { R_NEW, R_STATUS, R_RESULT, ROUTES };
+static const char *route_names[ROUTES] = { "new", "status", "result" };
+
+struct samples {
+    uint64_t *v;
+    size_t n, cap;
+};
+
+struct stats {
+    struct samples corrected[ROUTES], service[ROUTES];
+    unsigned long long errors[ROUTES];
+};
+
+struct conn {
+    int fd;
+    char buf[BUF_SIZE];
+    size_t len;
+};
+
+static const char *host = "localhost";
+static const char *port = "8000";
+static int threads = 4;
+static double rate = 0;  // 0 = lazo cerrado, lo mas rapido posible
+static double duration = 10;
+static int mix[ROUTES] = { 1, 8, 1 };
+static int cantidad = 10;
+static int digitos = 12;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t t) {
+    uint64_t now = now_ns();
+    if (t <= now) return;
+    struct timespec ts = { (time_t)((t - now) / 1000000000ULL), (long)((t - now) % 1000000000ULL) };
+    nanosleep(&ts, NULL);
+}
+
+static void samples_add(struct samples *s, uint64_t v) {
+    if (s->n == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 4096;
+        s->v = realloc(s->v, s->cap * sizeof(uint64_t));
+    }
+    s->v[s->n++] = v;
+}
+
+static void conn_close(struct conn *c) {
+    if (c->fd >= 0) close(c->fd);
+    c->fd = -1;
+    c->len = 0;
+}
+
+static int conn_open(struct conn *c) {
+    struct addrinfo hints = { 0 }, *res;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res) != 0) return -1;
+    c->fd = -1;
+    for (struct addrinfo *a = res; a; a = a->ai_next) {
+        int fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            c->fd = fd;
+            break;
+        }
+        close(fd);
+    }
+    freeaddrinfo(res);
+    c->len = 0;
+    return c->fd >= 0 ? 0 : -1;
+}
+
+static int send_all(int fd, const char *p, size_t n) {
+    while (n > 0) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return -1;
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+static int fill(struct conn *c) {
+    if (c->len == BUF_SIZE) return -1;
+    ssize_t r;
+    do r = recv(c->fd, c->buf + c->len, BUF_SIZE - c->len, 0); while (r < 0 && errno == EINTR);
+    if (r <= 0) return -1;
+    c->len += (size_t)r;
+    return 0;
+}
+
+static void consume(struct conn *c, size_t n) {
+    memmove(c->buf, c->buf + n, c->len - n);
+    c->len -= n;
+}
+
+// Descarta "n" bytes del cuerpo a medida que llegan.
+static int skip(struct conn *c, size_t n) {
+    while (n > 0) {
+        if (c->len == 0 && fill(c) != 0) return -1;
+        size_t k = c->len < n ? c->len : n;
+        consume(c, k);
+        n -= k;
+    }
+    return 0;
+}
+
+static char *find_crlf(struct conn *c) {
+    for (size_t i = 0; i + 1 < c->len; ++i) {
+        if (c->buf[i] == '\r' && c->buf[i + 1] == '\n') return c->buf + i;
+    }
+    return NULL;
+}
+
+// Lee una respuesta completa (Content-Length o chunked). Devuelve el status o
+// -1; los primeros bytes del cuerpo quedan en "body" si cabe (para /new).
+static int read_response(struct conn *c, char *body, size_t body_size) {
+    char *end;
+    while (!(end = memmem(c->buf, c->len, "\r\n\r\n", 4))) {
+        if (fill(c) != 0) return -1;
+    }
+    size_t hdr_len = (size_t)(end - c->buf) + 4;
+    char hdr[4096];
+    size_t n = hdr_len < sizeof(hdr) ? hdr_len : sizeof(hdr) - 1;
+    memcpy(hdr, c->buf, n);
+    hdr[n] = '\0';
+    consume(c, hdr_len);
+
+    int status = 0;
+    if (sscanf(hdr, "HTTP/1.%*d %d", &status) != 1) return -1;
+    long long content_length = -1;
+    int chunked = 0, keep_alive = 1;
+    for (char *line = strstr(hdr, "\r\n"); line && line[2]; line = strstr(line, "\r\n")) {
+        line += 2;
+        if (!strncasecmp(line, "Content-Length:", 15)) content_length = atoll(line + 15);
+        else if (!strncasecmp(line, "Transfer-Encoding: chunked", 26)) chunked = 1;
+        else if (!strncasecmp(line, "Connection: close", 17)) keep_alive = 0;
+    }
+    if (body_size) body[0] = '\0';
+
+    if (chunked) {
+        for (;;) {
+            char *eol;
+            while (!(eol = find_crlf(c))) {
+                if (fill(c) != 0) return -1;
+            }
+            size_t size = strtoul(c->buf, NULL, 16);
+            consume(c, (size_t)(eol - c->buf) + 2);
+            if (size == 0) {
+                if (skip(c, 2) != 0) return -1;
+                break;
+            }
+            if (skip(c, size + 2) != 0) return -1;
+        }
+    } else if (content_length >= 0) {
+        if ((size_t)content_length < body_size) {
+            while (c->len < (size_t)content_length) {
+                if (fill(c) != 0) return -1;
+            }
+            memcpy(body, c->buf, (size_t)content_length);
+            body[content_length] = '\0';
+        }
+        if (skip(c, (size_t)content_length) != 0) return -1;
+    }
+    if (!keep_alive) conn_close(c);
+    return status;
+}
+
+static int pick_route(unsigned *seed, int have_ids) {
+    int total = mix[R_NEW] + mix[R_STATUS] + mix[R_RESULT];
+    int x = rand_r(seed) % total;
+    int route = x < mix[R_NEW] ? R_NEW : x < mix[R_NEW] + mix[R_STATUS] ? R_STATUS : R_RESULT;
+    // Sin ids propios todavia, /status y /result no tienen a quien consultar
+    return have_ids ? route : R_NEW;
+}
+
+static void *run_thread(void *arg) {
+    struct stats *st = arg;
+    unsigned seed = (unsigned)(now_ns() ^ (uintptr_t)arg);
+    char ids[MAX_IDS][40];
+    int n_ids = 0, created = 0;
+    struct conn *c = malloc(sizeof(*c));
+    c->fd = -1;
+    c->len = 0;
+
+    uint64_t interval = rate > 0 ? (uint64_t)(1e9 * threads / rate) : 0;
+    uint64_t start = now_ns(), stop = start + (uint64_t)(duration * 1e9);
+    uint64_t intended = start;
+    char req[512], body[256];
+    while (intended < stop) {
+        if (interval) sleep_until(intended);
+        uint64_t sent = now_ns();
+        if (sent >= stop) break;
+        if (!interval) intended = sent;
+
+        int route = pick_route(&seed, n_ids > 0);
+        const char *id = n_ids ? ids[rand_r(&seed) % n_ids] : "";
+        int len;
+        if (route == R_NEW) {
+            char payload[64];
+            int plen = snprintf(payload, sizeof(payload), "{\"cantidad\":%d,\"digitos\":%d}", cantidad, digitos);
+            len = snprintf(req, sizeof(req), "POST /new HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\n"
+                "Content-Length: %d\r\n\r\n%s", host, plen, payload);
+        } else {
+            len = snprintf(req, sizeof(req), "GET /%s/%s HTTP/1.1\r\nHost: %s\r\n\r\n",
+                route == R_STATUS ? "status" : "result", id, host);
+        }
+
+        int status = -1;
+        for (int attempt = 0; attempt < 2 && status < 0; ++attempt) {
+            if (c->fd < 0 && conn_open(c) != 0) break;
+            if (send_all(c->fd, req, (size_t)len) == 0) {
+                status = read_response(c, body, route == R_NEW ? sizeof(body) : 0);
+            }
+            if (status < 0) conn_close(c);
+        }
+        uint64_t done = now_ns();
+
+        if (status < 200 || status >= 400) {
+            st->errors[route]++;
+        } else {
+            samples_add(&st->corrected[route], done - intended);
+            samples_add(&st->service[route], done - sent);
+            char *p = route == R_NEW ? strstr(body, "\"id\":\"") : NULL;
+            // Las ultimas MAX_IDS solicitudes creadas son las que se consultan
+            if (p && sscanf(p + 6, "%36[^\"]", ids[created % MAX_IDS]) == 1) {
+                created++;
+                n_ids = created < MAX_IDS ? created : MAX_IDS;
+            }
+        }
+        if (status < 0) sleep_until(now_ns() + 100000000ULL);  // API caida: no girar en vacio
+        if (interval) intended += interval;
+    }
+    conn_close(c);
+    free(c);
+    return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double pct_ms(const struct samples *s, double p) {
+    if (!s->n) return 0;
+    size_t i = (size_t)(p / 100.0 * s->n);
+    if (i >= s->n) i = s->n - 1;
+    return s->v[i] / 1e6;
+}
+
+static void merge(struct samples *dst, const struct samples *src) {
+    for (size_t i = 0; i < src->n; ++i) samples_add(dst, src->v[i]);
+}
+
+static void print_row(const char *name, const char *kind, struct samples *s, unsigned long long errors) {
+    qsort(s->v, s->n, sizeof(uint64_t), cmp_u64);
+    printf("%-7s %-10s %9zu %7llu %9.1f %9.2f %9.2f %9.2f %9.2f %9.2f\n", name, kind, s->n, errors,
+        s->n / duration, pct_ms(s, 50), pct_ms(s, 90), pct_ms(s, 99), pct_ms(s, 99.9),
+        s->n ? s->v[s->n - 1] / 1e6 : 0.0);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "uso: %s [-h host] [-p puerto] [-t hilos] [-r peticiones/s] [-d segundos]\n"
+                    "       [-m new,status,result] [-n cantidad] [-g digitos]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:t:r:d:m:n:g:")) != -1) {
+        switch (opt) {
+        case 'h': host = optarg; break;
+        case 'p': port = optarg; break;
+        case 't': threads = atoi(optarg); break;
+        case 'r': rate = atof(optarg); break;
+        case 'd': duration = atof(optarg); break;
+        case 'm':
+            if (sscanf(optarg, "%d,%d,%d", &mix[R_NEW], &mix[R_STATUS], &mix[R_RESULT]) != 3) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'n': cantidad = atoi(optarg); break;
+        case 'g': digitos = atoi(optarg); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (threads <= 0 || duration <= 0 || rate < 0 || mix[R_NEW] <= 0 || mix[R_STATUS] < 0 ||
+        mix[R_RESULT] < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("%s:%s, %d hilos keep-alive, %.0fs, ", host, port, threads, duration);
+    if (rate > 0) printf("lazo abierto a %.0f peticiones/s", rate);
+    else printf("lazo cerrado");
+    printf(", mezcla new/status/result %d/%d/%d\n", mix[R_NEW], mix[R_STATUS], mix[R_RESULT]);
+
+    pthread_t *tids = malloc(sizeof(pthread_t) * threads);
+    struct stats *st = calloc(threads, sizeof(struct stats));
+    for (int i = 0; i < threads; ++i) pthread_create(&tids[i], NULL, run_thread, &st[i]);
+    for (int i = 0; i < threads; ++i) pthread_join(tids[i], NULL);
+
+    printf("%-7s %-10s %9s %7s %9s %9s %9s %9s %9s %9s\n", "ruta", "latencia", "ok", "errores",
+        "req/s", "p50 ms", "p90 ms", "p99 ms", "p99.9 ms", "max ms");
+    struct stats total = { 0 };
+    for (int r = 0; r < ROUTES; ++r) {
+        for (int i = 0; i < threads; ++i) {
+            merge(&total.corrected[r], &st[i].corrected[r]);
+            merge(&total.service[r], &st[i].service[r]);
+            total.errors[r] += st[i].errors[r];
+            free(st[i].corrected[r].v);
+            free(st[i].service[r].v);
+        }
+        if (rate > 0) print_row(route_names[r], "corregida", &total.corrected[r], total.errors[r]);
+        print_row(route_names[r], "servicio", &total.service[r], total.errors[r]);
+        free(total.corrected[r].v);
+        free(total.service[r].v);
+    }
+    free(st);
+    free(tids);
+    return 0;
+}
@@ -0,0 +1,107 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "prime.h"
+
+// Micro-benchmark del motor de primos: el mismo bucle que process_job()
+// (gen_random_of_digits + is_probable_prime_stage) para cada largo de 2 a 20
+// digitos. Por largo hace una corrida de calentamiento y luego CORRIDAS
+// corridas de MS milisegundos; reporta mediana y percentiles entre corridas.
+// Salida CSV en stdout (una fila por largo), el resumen legible va a stderr.
+// Uso: ./prime_bench [CORRIDAS] [MS] [CPU]   (CPU = -1 no fija el hilo)
+
+#define MIN_DIGITS 2
+#define MAX_DIGITS 20
+#define CHECK_EVERY 256
+
+struct run {
+    double cand_s, primes_s, mr_ratio;
+};
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct run measure(int digits, double seconds) {
+    unsigned long long cand = 0, primes = 0, mr = 0;
+    double t0 = now_s(), elapsed;
+    do {
+        for (int i = 0; i < CHECK_EVERY; ++i) {
+            int reached_mr;
+            primes += is_probable_prime_stage(gen_random_of_digits(digits), &reached_mr);
+            mr += reached_mr;
+        }
+        cand += CHECK_EVERY;
+        elapsed = now_s() - t0;
+    } while (elapsed < seconds);
+    struct run r = { cand / elapsed, primes / elapsed, (double)mr / cand };
+    return r;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Percentil por rango mas cercano sobre un arreglo ya ordenado.
+static double percentile(const double *sorted, int n, double p) {
+    int i = (int)(p / 100.0 * n + 0.999999) - 1;
+    if (i < 0) i = 0;
+    if (i >= n) i = n - 1;
+    return sorted[i];
+}
+
+int main(int argc, char **argv) {
+    int runs = argc > 1 ? atoi(argv[1]) : 9;
+    int ms = argc > 2 ? atoi(argv[2]) : 200;
+    int cpu = argc > 3 ? atoi(argv[3]) : 0;
+    if (runs <= 0 || ms <= 0) {
+        fprintf(stderr, "uso: %s [CORRIDAS] [MS] [CPU]\n", argv[0]);
+        return 1;
+    }
+
+    // Fijar el hilo evita migraciones entre cores en medio de una corrida
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            fprintf(stderr, "aviso: no se pudo fijar la CPU %d, se sigue sin fijar\n", cpu);
+            cpu = -1;
+        }
+    }
+    fprintf(stderr, "%d corridas de %d ms por largo, cpu %d\n", runs, ms, cpu);
+
+    double *cand = malloc(sizeof(double) * runs);
+    double *primes = malloc(sizeof(double) * runs);
+    printf("digitos,corridas,cand_s_mediana,cand_s_p10,cand_s_p90,cand_s_min,cand_s_max,"
+           "primos_s_mediana,primos_s_p10,primos_s_p90,ns_por_candidato,fraccion_mr\n");
+    for (int d = MIN_DIGITS; d <= MAX_DIGITS; ++d) {
+        measure(d, ms / 1000.0);  // calentamiento: cache, predictor y frecuencia
+        double mr_ratio = 0;
+        for (int r = 0; r < runs; ++r) {
+            struct run res = measure(d, ms / 1000.0);
+            cand[r] = res.cand_s;
+            primes[r] = res.primes_s;
+            mr_ratio += res.mr_ratio / runs;
+        }
+        qsort(cand, runs, sizeof(double), cmp_double);
+        qsort(primes, runs, sizeof(double), cmp_double);
+        double med = percentile(cand, runs, 50);
+        printf("%d,%d,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%.1f,%.4f\n", d, runs, med,
+            percentile(cand, runs, 10), percentile(cand, runs, 90), cand[0], cand[runs - 1],
+            percentile(primes, runs, 50), percentile(primes, runs, 10), percentile(primes, runs, 90),
+            1e9 / med, mr_ratio);
+        fflush(stdout);
+        fprintf(stderr, "%2d digitos: %12.0f cand/s %12.0f primos/s (p10-p90 cand/s %.0f-%.0f)\n", d,
+            med, percentile(primes, runs, 50), percentile(cand, runs, 10), percentile(cand, runs, 90));
+    }
+    free(cand);
+    free(primes);
+    return 0;
+}
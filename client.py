@@ -48,12 +48,13 @@ class PrimesClient:
             print(f"✗ Error de conexión: {e}")
             return None
     
-    def get_status(self, request_id: str) -> Optional[dict]:
+    def get_status(self, request_id: str, wait: int = 0) -> Optional[dict]:
         """
         Obtiene el estado de una solicitud
         
         Args:
             request_id: ID de la solicitud
+            wait: Segundos que el servidor puede retener la petición hasta que termine
             
         Returns:
             Diccionario con estado o None si hay error
@@ -61,7 +62,8 @@ class PrimesClient:
         try:
             resp = self.session.get(
                 f"{self.base_url}/status/{request_id}",
-                timeout=5
+                params={"wait": wait} if wait > 0 else None,
+                timeout=wait + 5
             )
             if resp.status_code == 200:
                 return resp.json()
@@ -75,12 +77,13 @@ class PrimesClient:
             print(f"✗ Error de conexión: {e}")
             return None
     
-    def get_result(self, request_id: str) -> Optional[dict]:
+    def get_result(self, request_id: str, wait: int = 0) -> Optional[dict]:
         """
         Obtiene los números primos generados
         
         Args:
             request_id: ID de la solicitud
+            wait: Segundos que el servidor puede retener la petición hasta que termine
             
         Returns:
             Diccionario con los primos o None si hay error
@@ -88,7 +91,8 @@ class PrimesClient:
         try:
             resp = self.session.get(
                 f"{self.base_url}/result/{request_id}",
-                timeout=5
+                params={"wait": wait} if wait > 0 else None,
+                timeout=wait + 5
             )
             if resp.status_code == 200:
                 return resp.json()
@@ -109,7 +113,7 @@ class PrimesClient:
         Args:
             request_id: ID de la solicitud
             max_wait: Tiempo máximo de espera en segundos
-            interval: Intervalo de sondeo en segundos
+            interval: Pausa entre consultas si el servidor responde sin esperar
             
         Returns:
             True si se completó, False si se acabó el tiempo
@@ -118,7 +122,10 @@ class PrimesClient:
         cantidad_total = None
         
         while time.time() - start_time < max_wait:
-            status = self.get_status(request_id)
+            # Long-poll: el servidor responde en cuanto la solicitud termina
+            wait = max(1, min(30, int(max_wait - (time.time() - start_time))))
+            t0 = time.time()
+            status = self.get_status(request_id, wait=wait)
             if not status:
                 return False
             
@@ -127,12 +134,16 @@ class PrimesClient:
                 print(f"  Total a generar: {cantidad_total}")
             
             generados = status.get("generados", 0)
-            print(f"  Progreso: {generados}/{cantidad_total}")
+            eta_ms = status.get("eta_ms")
+            eta = f" (ETA ~{eta_ms / 1000:.1f}s)" if eta_ms else ""
+            print(f"  Progreso: {generados}/{cantidad_total}{eta}")
             
             if generados >= cantidad_total:
                 return True
             
-            time.sleep(interval)
+            # Sin LISTEN ni pub/sub el servidor responde al instante
+            if time.time() - t0 < 1:
+                time.sleep(interval)
         
         return False
 
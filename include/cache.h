@@ -0,0 +1,32 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+
+// Cache LRU de cuerpos /result ya renderizados, acotado por bytes.
+// Solo para solicitudes completas: su cuerpo no vuelve a cambiar.
+// No es thread-safe; se usa desde el hilo de Mongoose.
+
+struct cache_entry {
+    char key[40];
+    char etag[20];          // "<fnv1a-64 hex>" incluyendo comillas
+    char *body;
+    size_t len;
+    char *gz;               // mismo cuerpo en gzip, si ya se pidio; NULL si no
+    size_t gz_len;
+    struct cache_entry *prev, *next;   // orden LRU
+    struct cache_entry *hnext;         // cadena del hash
+};
+
+int cache_init(size_t max_bytes);
+void cache_free(void);
+
+const struct cache_entry *cache_get(const char *key);
+const struct cache_entry *cache_put(const char *key, const char *body, size_t len);
+// Adjunta la version gzip del cuerpo (el cache toma posesion de "gz").
+void cache_set_gzip(const struct cache_entry *e, char *gz, size_t gz_len);
+
+size_t cache_bytes(void);
+size_t cache_count(void);
+
+#endif
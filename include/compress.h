@@ -0,0 +1,27 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stddef.h>
+#include <zlib.h>
+
+// Compresion gzip (zlib) para respuestas HTTP con Content-Encoding: gzip.
+
+// Comprime "len" bytes de una vez; *out se libera con free(). 0 ok, -1 error.
+int gzip_compress(const char *in, size_t len, int level, char **out, size_t *out_len);
+
+// Compresion incremental para respuestas chunked: cada gzip_stream_write()
+// devuelve en *out lo que deflate ya pudo emitir (puede ser 0 bytes) y
+// gzip_stream_finish() el resto mas el trailer gzip. *out apunta a un buffer
+// interno valido hasta la siguiente llamada.
+struct gzip_stream {
+    z_stream zs;
+    char *buf;
+    size_t cap;
+};
+
+int gzip_stream_init(struct gzip_stream *gs, int level);
+int gzip_stream_write(struct gzip_stream *gs, const char *in, size_t len, const char **out, size_t *out_len);
+int gzip_stream_finish(struct gzip_stream *gs, const char **out, size_t *out_len);
+void gzip_stream_free(struct gzip_stream *gs);
+
+#endif
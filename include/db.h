@@ -3,19 +3,44 @@
 
 #include <libpq-fe.h>
 #include <stdint.h>
-#include <hiredis/hiredis.h>
+#include "redis_client.h"
+
+struct job;
+
+// Cache de progreso en Redis: hash con cantidad, digitos y generados
+#define STATUS_KEY_FMT "primes:status:%s"
+#define STATUS_TTL_SECONDS 86400
+
+// Primos/s medidos por los workers para cada largo (campo = digitos), con los
+// que /status estima eta_ms
+#define RATES_KEY "primes:rates"
+
+// Canal NOTIFY con el id de cada solicitud que llega a generados == cantidad
+#define DONE_CHANNEL "solicitud_done"
+
+// DB_BACKEND: "postgres" (defecto) o "memory", un stand-in en memoria
+// (src/memstore.c) que cubre solo lo que usa el worker, para medir el pipeline
+// de generacion sin Postgres.
+enum db_backend {
+    DB_POSTGRES,
+    DB_MEMORY
+};
+
+enum db_backend db_configure(const char *name);
+enum db_backend db_get_backend(void);
 
 int db_init(const char *conninfo);
-void db_set_redis(redisContext *redis);
 void db_close();
 
 PGconn *db_open_connection(const char *conninfo);
 void db_close_connection(PGconn *c);
 
-int db_create_solicitud_and_enqueue(char *out_id, int cantidad, int digitos);
+int db_create_solicitud(char *out_id, int cantidad, int digitos);
+int db_outbox_relay_conn(PGconn *c, struct redis_client *rc, int max);
 
-int db_fetch_job_for_worker(char *out_job_id, char *out_solicitud_id, int *out_cantidad, int *out_digitos);
-int db_fetch_job_for_worker_conn(PGconn *c, char *out_job_id, char *out_solicitud_id, int *out_cantidad, int *out_digitos);
+int db_claim_jobs_conn(PGconn *c, const char *worker, int lease_seconds, struct job *jobs, int max);
+int db_renew_leases_conn(PGconn *c, const char *worker, int lease_seconds);
+int db_release_job_conn(PGconn *c, const char *job_id, int cantidad);
 
 int db_mark_job_done(const char *job_id);
 int db_mark_job_done_conn(PGconn *c, const char *job_id);
@@ -25,10 +50,18 @@ int db_insert_result_conn(PGconn *c, const char *solicitud_id, const char *primo
 
 int db_inc_generado(const char *solicitud_id);
 int db_inc_generado_conn(PGconn *c, const char *solicitud_id);
+int db_inc_generado_progress_conn(PGconn *c, const char *solicitud_id, int *out_generados, int *out_cantidad);
+int db_notify_done_conn(PGconn *c, const char *solicitud_id);
 
 
 int db_get_status(const char *solicitud_id, int *cantidad, int *digitos, int *generados);
+long long db_count_pending_jobs(void);
+// Primos que faltan generar (cantidad - generados) por digitos, sumando todas
+// las solicitudes incompletas: en cola, en outbox o a medias en un worker.
+int db_pending_primes(double primes_by_digits[21]);
 char ** db_get_results(const char *solicitud_id, int *count);
+// Hasta "limit" primos mayores que "after" ("" desde el principio), ordenados.
+char ** db_get_results_page(const char *solicitud_id, const char *after, int limit, int *count);
 void db_free_results(char **arr, int count);
 
 #endif
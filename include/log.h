@@ -0,0 +1,32 @@
+#ifndef LOG_H
+#define LOG_H
+
+// Logger asincrono: log_write() formatea en una ranura de un ring buffer
+// lock-free (varios productores, un consumidor) y un hilo de fondo lo vuelca
+// a stdout/stderr. Si el buffer esta lleno la linea se descarta y se cuenta,
+// asi loguear nunca bloquea al hilo que llama.
+//
+// LOG_LEVEL=error|warn|info|debug (info por defecto), LOG_FORMAT=text|json,
+// LOG_SAMPLE=N: log_sampled() deja pasar 1 de cada N eventos (100 por defecto)
+// y como mucho LOG_SAMPLE_MAX por segundo (50 por defecto) por hilo.
+// Los mensajes llevan su propio prefijo ("[worker] ...") y salto de linea;
+// error y warn van a stderr, el resto a stdout.
+
+enum log_level { LOG_ERROR, LOG_WARN, LOG_INFO, LOG_DEBUG };
+
+// Lee la configuracion del entorno y arranca el hilo de volcado. Antes de
+// llamarla (o si el hilo no arranca) log_write() escribe directo.
+void log_init(void);
+// Vacia lo pendiente y detiene el hilo; tambien corre solo con atexit().
+void log_shutdown(void);
+
+void log_configure(const char *level_name);
+int log_enabled(int level);
+void log_write(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Para eventos de alta frecuencia (uno por primo): 1 si este debe loguearse.
+int log_sampled(void);
+
+unsigned long long log_dropped(void);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef MEMSTORE_H
+#define MEMSTORE_H
+
+// Stand-in en memoria de las tablas solicitudes y resultados para correr el
+// worker sin Postgres (DB_BACKEND=memory). Los ids los genera el propio store
+// con forma de uuid y codifican el indice de la fila. Thread-safe.
+
+int memstore_create(char *out_id, int cantidad, int digitos);
+// 0, o -2 si la solicitud no existe
+int memstore_get_status(const char *solicitud_id, int *cantidad, int *digitos, int *generados);
+// 0, -2 si el primo ya estaba (como el indice UNIQUE de resultados) o -1
+int memstore_insert_result(const char *solicitud_id, const char *primo);
+int memstore_inc_generado(const char *solicitud_id, int *out_generados, int *out_cantidad);
+// Suma lo que falta generar de cada solicitud incompleta, por digitos.
+void memstore_pending_primes(double primes_by_digits[21]);
+long long memstore_results(void);
+void memstore_free(void);
+
+#endif
@@ -4,6 +4,9 @@
 #include <stdint.h>
 
 int is_probable_prime(uint64_t n);
+// Igual, pero indica en *reached_mr si el candidato paso la division por primos
+// chicos y llego a Miller-Rabin (para las metricas del worker).
+int is_probable_prime_stage(uint64_t n, int *reached_mr);
 uint64_t gen_random_of_digits(int digits);
 char *u64_to_str(uint64_t v);
 
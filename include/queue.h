@@ -0,0 +1,98 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <hiredis/hiredis.h>
+#include "redis_client.h"
+#include "trace.h"
+
+// Transporte de jobs entre API y workers, seleccionado con QUEUE_BACKEND:
+//   list   - listas primes:queue:<clase> con BLMOVE a una lista processing por
+//            worker (defecto)
+//   stream - Redis Streams primes:stream:<clase> con consumer group, XACK y
+//            XAUTOCLAIM
+//   postgres - tabla "cola" con reclamo por lotes (SKIP LOCKED), leases y
+//            LISTEN/NOTIFY; no necesita Redis
+//   memory - ring buffer en proceso sembrado al iniciar el worker con
+//            BENCH_JOBS jobs de BENCH_CANTIDAD primos de BENCH_DIGITOS digitos;
+//            junto con DB_BACKEND=memory mide el worker sin Redis ni Postgres
+//
+// Cada job se enruta a una clase por costo estimado (cantidad x costo por
+// digito) y los workers sirven las clases con round robin ponderado
+// (QUEUE_WEIGHTS, por defecto "6,3,1"), asi un lote de jobs grandes no deja
+// sin servicio a los interactivos.
+
+enum queue_backend {
+    QUEUE_LIST,
+    QUEUE_STREAM,
+    QUEUE_POSTGRES,
+    QUEUE_MEMORY
+};
+
+enum job_class {
+    JOB_SMALL,
+    JOB_MEDIUM,
+    JOB_LARGE,
+    JOB_CLASSES
+};
+
+#define QUEUE_KEY_FMT "primes:queue:%s"
+#define QUEUE_STREAM_KEY_FMT "primes:stream:%s"
+#define QUEUE_WAIT_KEY_FMT "primes:stats:qwait:%s"
+#define QUEUE_GROUP "primes-workers"
+#define QUEUE_NOTIFY_CHANNEL "cola_nueva"
+
+// Job recibido. "ref" identifica la entrega: el string exacto en la lista de
+// processing (list), el ID de la entrada (stream) o el id de la fila (postgres).
+struct job {
+    char ref[256];
+    char solicitud_id[64];
+    int cantidad;
+    int digitos;
+    int job_class;
+    long long enqueued_ms;  // epoch ms en que la API lo encolo (0 = desconocido)
+    char trace_id[TRACE_ID_LEN + 1];  // vacio = sin trace
+};
+
+// Devuelve cuantos primos faltan realmente para el job (0 = ya completo,
+// -1 = desconocido). Lo aporta el worker, que es quien consulta Postgres.
+typedef int (*queue_remaining_fn)(const struct job *job);
+
+enum queue_backend queue_configure(const char *name);
+enum queue_backend queue_get_backend(void);
+const char *queue_backend_name(void);
+
+int queue_job_class(int cantidad, int digitos);
+const char *queue_class_name(int job_class);
+long long queue_now_ms(void);
+
+int queue_format_job(char *buf, size_t n, const char *solicitud_id, int cantidad,
+                     int digitos, long long enqueued_ms, const char *trace_id);
+int queue_parse_job(const char *job_str, struct job *job);
+
+// Lado API: agrega el comando de encolado al pipeline (una respuesta pendiente).
+// enqueued_ms es la creacion de la solicitud, asi la espera incluye el outbox.
+int queue_append_push(struct redis_client *rc, const char *solicitud_id, int cantidad, int digitos,
+                      long long enqueued_ms);
+
+// Trabajos en cola sumando todas las clases (LLEN / XLEN, o filas pendientes
+// de cola con el backend postgres); -1 si no se pudo consultar.
+long long queue_depth(struct redis_client *rc);
+
+// Costo relativo de un primo de "digitos" digitos (el del clasificador).
+int queue_digit_cost(int digitos);
+
+// Lado worker. Con el backend postgres "c" puede ser NULL y la cola usa su
+// propia conexion a db_url.
+int queue_worker_init(redisContext *c, const char *worker_id, const char *db_url,
+                      queue_remaining_fn remaining);
+int queue_fetch(redisContext *c, struct job *jobs, int max);
+void queue_ack(redisContext *c, const struct job *job);
+void queue_requeue(redisContext *c, const struct job *job, int remaining);
+void queue_record_wait(redisContext *c, const struct job *job);
+void queue_heartbeat(redisContext *c, int force);
+void queue_recover(redisContext *c);
+void queue_worker_shutdown(redisContext *c);
+// memory: 1 cuando no queda nada en el ring ni entregado sin ack/requeue.
+int queue_drained(void);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef REDIS_ASYNC_H
+#define REDIS_ASYNC_H
+
+#include <hiredis/async.h>
+#include "mongoose.h"
+
+// Conexion hiredis asincrona cuyo socket atiende el loop de Mongoose: los
+// comandos no bloquean el hilo HTTP y las respuestas llegan como callbacks
+// dentro de mg_mgr_poll(). Si la conexion cae se reintenta cada segundo.
+// Solo se usa desde el hilo de Mongoose.
+
+int redis_async_init(struct mg_mgr *mgr, const char *host, int port);
+void redis_async_free(void);
+
+// Contexto listo para redisAsyncCommand(); NULL mientras no haya conexion.
+redisAsyncContext *redis_async_ctx(void);
+
+#endif
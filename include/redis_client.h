@@ -0,0 +1,59 @@
+#ifndef REDIS_CLIENT_H
+#define REDIS_CLIENT_H
+
+#include <hiredis/hiredis.h>
+
+// Conexion Redis bloqueante compartida por API y worker: se reconecta sola con
+// backoff exponencial cuando la conexion cae y cuenta latencias por round trip.
+// Cada instancia pertenece a un solo hilo.
+
+struct redis_stats {
+    unsigned long long round_trips;
+    unsigned long long commands;
+    unsigned long long errors;
+    unsigned long long reconnects;
+    unsigned long long total_us;
+    unsigned long long max_us;
+};
+
+struct redis_client {
+    redisContext *ctx;
+    char host[256];
+    int port;
+    int timeout_ms;             // timeout de lectura; 0 = bloquear sin limite
+    int connected_once;
+    int backoff_ms;
+    long long retry_at_ms;
+    int pending;                // respuestas de pipeline aun sin leer
+    int batch;                  // comandos en el pipeline actual
+    long long pipeline_start_us;
+    struct redis_stats stats;
+    int latency_metric;         // histograma de metrics.h por round trip; -1 si no
+
+};
+
+struct redis_client *redis_client_open(const char *host, int port);
+void redis_client_close(struct redis_client *rc);
+// Timeout de lectura para esta conexion y las siguientes. Un comando que lo
+// excede devuelve NULL y la conexion se rehace; no se reintenta.
+void redis_client_set_timeout(struct redis_client *rc, int timeout_ms);
+
+// Contexto conectado, reconectando si hace falta; NULL mientras Redis no
+// responda (el siguiente intento respeta el backoff).
+redisContext *redis_client_ctx(struct redis_client *rc);
+
+// Un comando con su respuesta. Ante un error de conexion reconecta y lo
+// reintenta una vez.
+redisReply *redis_client_command(struct redis_client *rc, const char *fmt, ...);
+
+// Pipelining: encolar con redis_client_append() (o directo sobre el contexto y
+// avisar con redis_client_pipelined()) y leer cada respuesta en orden con
+// redis_client_get_reply(). Tras un error las respuestas pendientes se pierden.
+int redis_client_append(struct redis_client *rc, const char *fmt, ...);
+void redis_client_pipelined(struct redis_client *rc, int n);
+redisReply *redis_client_get_reply(struct redis_client *rc);
+void redis_client_discard(struct redis_client *rc);
+
+void redis_client_get_stats(const struct redis_client *rc, struct redis_stats *out);
+
+#endif
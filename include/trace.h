@@ -0,0 +1,44 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Spans de tracing por solicitud, exportados como OTLP/JSON (un
+// ExportTraceServiceRequest por linea) al archivo TRACE_FILE; sin TRACE_FILE
+// no se registra nada. El trace id es el uuid de la solicitud sin guiones y el
+// span raiz (POST /new en la API) usa sus primeros 16 digitos como span id, asi
+// API y worker arman el mismo arbol sin propagar mas que el trace id, que viaja
+// en el string del job.
+
+#define TRACE_ID_LEN 32
+#define SPAN_ID_LEN 16
+
+struct span_attr {
+    const char *key;
+    long long value;
+};
+
+void trace_init(const char *service_name);
+void trace_shutdown(void);
+int trace_enabled(void);
+
+// Epoch en nanosegundos (los spans de API y worker se comparan entre procesos).
+uint64_t trace_now_ns(void);
+
+// "out" debe tener TRACE_ID_LEN + 1 bytes; queda vacio si "uuid" no es valido.
+void trace_id_from_uuid(const char *uuid, char *out);
+// Span id del span raiz de la solicitud (SPAN_ID_LEN + 1 bytes).
+void trace_root_span_id(const char *trace_id, char *out);
+
+// Span id nuevo (SPAN_ID_LEN + 1 bytes), para abrir un span con hijos.
+void trace_new_span_id(char *out);
+
+// Registra un span terminado. "span_id" puede ser NULL (se genera uno) y
+// "parent_id" NULL o "" para un span raiz. Thread-safe.
+void trace_span(const char *trace_id, const char *span_id, const char *parent_id, const char *name,
+                uint64_t start_ns, uint64_t end_ns, const struct span_attr *attrs, int n_attrs);
+
+// Escribe lo acumulado (tambien se hace solo cada TRACE_BATCH spans).
+void trace_flush(void);
+
+#endif
@@ -231,7 +231,7 @@ echo "Todas las solicitudes han sido creadas"
 # Monitorear la cola
 echo ""
 echo "Monitoreando Redis queue:"
-watch -n 1 'redis-cli LLEN primes:queue'
+watch -n 1 'for c in small medium large; do redis-cli LLEN primes:queue:$c; done'
 EOF
 
 echo "$ cat > stress_test.sh << 'EOF'"
@@ -0,0 +1,53 @@
+#!/bin/bash
+
+# Benchmark de latencia de GET /status/{id} bajo polling intenso
+# Uso: ./bench-status.sh [API_URL] [PETICIONES] [CONCURRENCIA]
+#
+# Compara el camino cacheado en Redis contra Postgres ejecutando primero con
+# el cache caliente y luego borrando el hash antes de cada peticion (requiere
+# redis-cli; REDIS_HOST/REDIS_PORT opcionales).
+
+API_URL="${1:-http://localhost:8000}"
+REQUESTS="${2:-2000}"
+CONCURRENCY="${3:-32}"
+REDIS_CLI="redis-cli -h ${REDIS_HOST:-localhost} -p ${REDIS_PORT:-6379}"
+
+REQUEST_ID=$(curl -s -X POST "$API_URL/new" \
+  -H "Content-Type: application/json" \
+  -d '{"cantidad":1000,"digitos":20}' | grep -o '"id":"[^"]*' | cut -d'"' -f4)
+
+if [ -z "$REQUEST_ID" ]; then
+    echo "✗ Error: No se pudo crear la solicitud"
+    exit 1
+fi
+
+# Imprime p50/p90/p99/max (ms) de una lista de tiempos en segundos
+percentiles() {
+    sort -n | awk '{ t[NR] = $1 * 1000 }
+        END {
+            if (NR == 0) { print "sin datos"; exit }
+            printf "n=%d p50=%.2fms p90=%.2fms p99=%.2fms max=%.2fms\n", NR,
+                t[int(NR * 0.50) > 0 ? int(NR * 0.50) : 1],
+                t[int(NR * 0.90) > 0 ? int(NR * 0.90) : 1],
+                t[int(NR * 0.99) > 0 ? int(NR * 0.99) : 1], t[NR]
+        }'
+}
+
+poll() {
+    seq "$REQUESTS" | xargs -P "$CONCURRENCY" -I{} \
+        curl -s -o /dev/null -w '%{time_total}\n' "$API_URL/status/$REQUEST_ID"
+}
+
+echo "Solicitud: $REQUEST_ID  peticiones=$REQUESTS  concurrencia=$CONCURRENCY"
+
+echo -n "Redis (cache caliente):   "
+poll | percentiles
+
+if command -v redis-cli > /dev/null; then
+    echo -n "Postgres (cache borrado): "
+    seq "$REQUESTS" | xargs -P "$CONCURRENCY" -I{} sh -c \
+        "$REDIS_CLI DEL primes:status:$REQUEST_ID > /dev/null; \
+         curl -s -o /dev/null -w '%{time_total}\n' '$API_URL/status/$REQUEST_ID'" | percentiles
+else
+    echo "redis-cli no disponible: se omite la comparacion con Postgres"
+fi
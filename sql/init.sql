@@ -15,3 +15,43 @@ CREATE TABLE IF NOT EXISTS resultados (
 );
 
 CREATE UNIQUE INDEX IF NOT EXISTS idx_primo_global ON resultados (primo);
+-- Orden numerico de los primos (TEXT) para paginar /result por clave
+CREATE INDEX IF NOT EXISTS idx_resultados_orden ON resultados (solicitud_id, length(primo), primo);
+
+-- Outbox transaccional: cada solicitud se inserta junto con su fila aqui y el
+-- relay de la API la pasa a la cola de Redis (y la borra) en lotes.
+CREATE TABLE IF NOT EXISTS outbox (
+    id BIGSERIAL PRIMARY KEY,
+    solicitud_id UUID NOT NULL REFERENCES solicitudes(id) ON DELETE CASCADE,
+    cantidad INT NOT NULL,
+    digitos INT NOT NULL,
+    creado_en TIMESTAMP DEFAULT NOW()
+);
+
+-- Cola en Postgres (QUEUE_BACKEND=postgres): los workers reclaman lotes con
+-- FOR UPDATE SKIP LOCKED y renuevan un lease; un lease vencido vuelve a estar
+-- disponible. Cada INSERT avisa a los workers con NOTIFY cola_nueva.
+CREATE TABLE IF NOT EXISTS cola (
+    id UUID PRIMARY KEY DEFAULT uuid_generate_v4(),
+    solicitud_id UUID NOT NULL REFERENCES solicitudes(id) ON DELETE CASCADE,
+    cantidad INT NOT NULL,
+    digitos INT NOT NULL,
+    procesado BOOLEAN NOT NULL DEFAULT FALSE,
+    worker TEXT,
+    lease_hasta TIMESTAMP,
+    creado_en TIMESTAMP DEFAULT NOW()
+);
+
+CREATE INDEX IF NOT EXISTS idx_cola_pendiente ON cola (creado_en) WHERE procesado = FALSE;
+CREATE INDEX IF NOT EXISTS idx_cola_lease ON cola (lease_hasta) WHERE procesado = TRUE;
+
+CREATE OR REPLACE FUNCTION notificar_cola() RETURNS trigger AS $$
+BEGIN
+    PERFORM pg_notify('cola_nueva', '');
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+DROP TRIGGER IF EXISTS cola_nueva ON cola;
+CREATE TRIGGER cola_nueva AFTER INSERT ON cola
+    FOR EACH STATEMENT EXECUTE FUNCTION notificar_cola();
@@ -0,0 +1,127 @@
+#define _POSIX_C_SOURCE 200809L
+#include "cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define CACHE_BUCKETS 4096
+
+static struct cache_entry *buckets[CACHE_BUCKETS];
+static struct cache_entry *lru_head = NULL, *lru_tail = NULL;
+static size_t max_bytes_global = 0;
+static size_t used_bytes = 0;
+static size_t n_entries = 0;
+
+static uint64_t fnv1a(const char *s, size_t len) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static size_t bucket_of(const char *key) {
+    return (size_t)(fnv1a(key, strlen(key)) % CACHE_BUCKETS);
+}
+
+static size_t entry_cost(const struct cache_entry *e) {
+    return e->len + e->gz_len + sizeof(*e);
+}
+
+static void lru_unlink(struct cache_entry *e) {
+    if (e->prev) e->prev->next = e->next; else lru_head = e->next;
+    if (e->next) e->next->prev = e->prev; else lru_tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void lru_push_front(struct cache_entry *e) {
+    e->prev = NULL;
+    e->next = lru_head;
+    if (lru_head) lru_head->prev = e;
+    lru_head = e;
+    if (!lru_tail) lru_tail = e;
+}
+
+static void entry_remove(struct cache_entry *e) {
+    struct cache_entry **pp = &buckets[bucket_of(e->key)];
+    while (*pp && *pp != e) pp = &(*pp)->hnext;
+    if (*pp) *pp = e->hnext;
+    lru_unlink(e);
+    used_bytes -= entry_cost(e);
+    n_entries--;
+    free(e->body);
+    free(e->gz);
+    free(e);
+}
+
+int cache_init(size_t max_bytes) {
+    cache_free();
+    max_bytes_global = max_bytes;
+    return 0;
+}
+
+void cache_free(void) {
+    while (lru_tail) entry_remove(lru_tail);
+    memset(buckets, 0, sizeof(buckets));
+}
+
+const struct cache_entry *cache_get(const char *key) {
+    for (struct cache_entry *e = buckets[bucket_of(key)]; e; e = e->hnext) {
+        if (strcmp(e->key, key) == 0) {
+            if (e != lru_head) {
+                lru_unlink(e);
+                lru_push_front(e);
+            }
+            return e;
+        }
+    }
+    return NULL;
+}
+
+const struct cache_entry *cache_put(const char *key, const char *body, size_t len) {
+    if (strlen(key) >= sizeof(((struct cache_entry *)0)->key)) return NULL;
+    if (len + sizeof(struct cache_entry) > max_bytes_global) return NULL;
+
+    const struct cache_entry *old = cache_get(key);
+    if (old) entry_remove((struct cache_entry *)old);
+
+    struct cache_entry *e = calloc(1, sizeof(*e));
+    if (!e) return NULL;
+    e->body = malloc(len);
+    if (!e->body) { free(e); return NULL; }
+    memcpy(e->body, body, len);
+    e->len = len;
+    snprintf(e->key, sizeof(e->key), "%s", key);
+    snprintf(e->etag, sizeof(e->etag), "\"%016llx\"", (unsigned long long)fnv1a(body, len));
+
+    while (lru_tail && used_bytes + entry_cost(e) > max_bytes_global) entry_remove(lru_tail);
+
+    size_t b = bucket_of(e->key);
+    e->hnext = buckets[b];
+    buckets[b] = e;
+    lru_push_front(e);
+    used_bytes += entry_cost(e);
+    n_entries++;
+    return e;
+}
+
+void cache_set_gzip(const struct cache_entry *ce, char *gz, size_t gz_len) {
+    struct cache_entry *e = (struct cache_entry *)ce;
+    used_bytes -= entry_cost(e);
+    free(e->gz);
+    e->gz = gz;
+    e->gz_len = gz_len;
+    used_bytes += entry_cost(e);
+    // La entrada recien usada esta al frente: se desalojan las demas
+    while (lru_tail && lru_tail != e && used_bytes > max_bytes_global) entry_remove(lru_tail);
+}
+
+size_t cache_bytes(void) {
+    return used_bytes;
+}
+
+size_t cache_count(void) {
+    return n_entries;
+}
@@ -0,0 +1,84 @@
+#define _POSIX_C_SOURCE 200809L
+#include "compress.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define GZIP_WINDOW_BITS (15 + 16)  // +16: cabecera y trailer gzip en vez de zlib
+#define GZIP_MEM_LEVEL 8
+
+int gzip_compress(const char *in, size_t len, int level, char **out, size_t *out_len) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, level, Z_DEFLATED, GZIP_WINDOW_BITS, GZIP_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return -1;
+    }
+    size_t cap = deflateBound(&zs, (uLong)len);
+    char *buf = malloc(cap);
+    if (!buf) {
+        deflateEnd(&zs);
+        return -1;
+    }
+    zs.next_in = (Bytef *)in;
+    zs.avail_in = (uInt)len;
+    zs.next_out = (Bytef *)buf;
+    zs.avail_out = (uInt)cap;
+    int r = deflate(&zs, Z_FINISH);
+    size_t n = zs.total_out;
+    deflateEnd(&zs);
+    if (r != Z_STREAM_END) {
+        free(buf);
+        return -1;
+    }
+    *out = buf;
+    *out_len = n;
+    return 0;
+}
+
+int gzip_stream_init(struct gzip_stream *gs, int level) {
+    memset(gs, 0, sizeof(*gs));
+    if (deflateInit2(&gs->zs, level, Z_DEFLATED, GZIP_WINDOW_BITS, GZIP_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return -1;
+    }
+    return 0;
+}
+
+static int run(struct gzip_stream *gs, const char *in, size_t len, int flush,
+               const char **out, size_t *out_len) {
+    gs->zs.next_in = (Bytef *)in;
+    gs->zs.avail_in = (uInt)len;
+    size_t used = 0;
+    for (;;) {
+        if (gs->cap - used < 256) {
+            size_t cap = gs->cap ? gs->cap * 2 : deflateBound(&gs->zs, (uLong)len) + 256;
+            char *b = realloc(gs->buf, cap);
+            if (!b) return -1;
+            gs->buf = b;
+            gs->cap = cap;
+        }
+        gs->zs.next_out = (Bytef *)gs->buf + used;
+        gs->zs.avail_out = (uInt)(gs->cap - used);
+        int r = deflate(&gs->zs, flush);
+        if (r == Z_STREAM_ERROR) return -1;
+        used = gs->cap - gs->zs.avail_out;
+        // Termina cuando deflate consumio todo y no le falto salida
+        if (flush == Z_FINISH ? r == Z_STREAM_END : gs->zs.avail_in == 0 && gs->zs.avail_out != 0) break;
+    }
+    *out = gs->buf;
+    *out_len = used;
+    return 0;
+}
+
+int gzip_stream_write(struct gzip_stream *gs, const char *in, size_t len, const char **out, size_t *out_len) {
+    return run(gs, in, len, Z_NO_FLUSH, out, out_len);
+}
+
+int gzip_stream_finish(struct gzip_stream *gs, const char **out, size_t *out_len) {
+    return run(gs, NULL, 0, Z_FINISH, out, out_len);
+}
+
+void gzip_stream_free(struct gzip_stream *gs) {
+    deflateEnd(&gs->zs);
+    free(gs->buf);
+    gs->buf = NULL;
+    gs->cap = 0;
+}
@@ -1,23 +1,41 @@
 #define _POSIX_C_SOURCE 200809L
 #include "db.h"
+#include "queue.h"
+#include "log.h"
+#include "memstore.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <hiredis/hiredis.h>
 
 static char *conninfo_global = NULL;
+static enum db_backend backend = DB_POSTGRES;
+
+// Con el backend memory las conexiones son este marcador: los *_conn que usa
+// el worker lo reconocen y van a memstore.
+static char memory_conn_marker;
+#define MEMORY_CONN ((PGconn *)&memory_conn_marker)
+
+enum db_backend db_configure(const char *name) {
+    backend = name && strcasecmp(name, "memory") == 0 ? DB_MEMORY : DB_POSTGRES;
+    return backend;
+}
+
+enum db_backend db_get_backend(void) {
+    return backend;
+}
 static __thread PGconn *thread_conn = NULL;
-static redisContext *redis_global = NULL;
 
 static PGconn *get_conn(void) {
     if (thread_conn) return thread_conn;
     if (!conninfo_global) {
-        fprintf(stderr, "db not initialized (no conninfo)\n");
+        log_write(LOG_ERROR, "[db] Not initialized (no conninfo)\n");
         return NULL;
     }
     thread_conn = PQconnectdb(conninfo_global);
     if (PQstatus(thread_conn) != CONNECTION_OK) {
-        fprintf(stderr, "Thread DB connect error: %s\n", PQerrorMessage(thread_conn));
+        log_write(LOG_ERROR, "[db] Thread connect error: %s\n", PQerrorMessage(thread_conn));
         PQfinish(thread_conn);
         thread_conn = NULL;
         return NULL;
@@ -26,12 +44,13 @@ static PGconn *get_conn(void) {
 }
 
 int db_init(const char *conninfo) {
+    if (backend == DB_MEMORY) return 0;
     if (conninfo_global) free(conninfo_global);
     conninfo_global = strdup(conninfo);
     if (!conninfo_global) return -1;
     PGconn *c = PQconnectdb(conninfo_global);
     if (PQstatus(c) != CONNECTION_OK) {
-        fprintf(stderr, "DB connect error: %s\n", PQerrorMessage(c));
+        log_write(LOG_ERROR, "[db] Connect error: %s\n", PQerrorMessage(c));
         PQfinish(c);
         return -1;
     }
@@ -39,20 +58,17 @@ int db_init(const char *conninfo) {
     return 0;
 }
 
-void db_set_redis(redisContext *redis) {
-    redis_global = redis;
-}
-
 void db_close() {
+    if (backend == DB_MEMORY) memstore_free();
     if (conninfo_global) { free(conninfo_global); conninfo_global = NULL; }
     if (thread_conn) { PQfinish(thread_conn); thread_conn = NULL; }
-    if (redis_global) { redisFree(redis_global); redis_global = NULL; }
 }
 
 PGconn *db_open_connection(const char *conninfo) {
+    if (backend == DB_MEMORY) return MEMORY_CONN;
     PGconn *c = PQconnectdb(conninfo);
     if (PQstatus(c) != CONNECTION_OK) {
-        fprintf(stderr, "DB connection error: %s\n", PQerrorMessage(c));
+        log_write(LOG_ERROR, "[db] Connection error: %s\n", PQerrorMessage(c));
         PQfinish(c);
         return NULL;
     }
@@ -60,32 +76,40 @@ PGconn *db_open_connection(const char *conninfo) {
 }
 
 void db_close_connection(PGconn *c) {
-    if (c) PQfinish(c);
+    if (c && c != MEMORY_CONN) PQfinish(c);
 }
 
 
-int db_create_solicitud_and_enqueue(char *out_id, int cantidad, int digitos) {
-    int rc = -1;
+// La solicitud y su fila de outbox (o de cola) se insertan en una sola sentencia: una
+// transaccion y un round trip. El relay del servidor la lleva luego a Redis.
+int db_create_solicitud(char *out_id, int cantidad, int digitos) {
+    if (backend == DB_MEMORY) return memstore_create(out_id, cantidad, digitos);
     PGconn *c = get_conn();
     if (!c) return -1;
 
-    PGresult *res = PQexec(c, "BEGIN");
-    if (PQresultStatus(res) != PGRES_COMMAND_OK) { PQclear(res); return -1; }
-    PQclear(res);
-
     char cant_str[32], digs_str[32];
     snprintf(cant_str, sizeof(cant_str), "%d", cantidad);
     snprintf(digs_str, sizeof(digs_str), "%d", digitos);
     const char *paramValues[2] = { cant_str, digs_str };
     
-    res = PQexecParams(c,
-        "INSERT INTO solicitudes (cantidad, digitos) VALUES ($1::int, $2::int) RETURNING id",
+    // Con QUEUE_BACKEND=postgres el job va directo a "cola" (su trigger
+    // notifica a los workers); si no, al outbox que vacia el relay.
+    PGresult *res = PQexecParams(c, queue_get_backend() == QUEUE_POSTGRES ?
+        "WITH s AS (INSERT INTO solicitudes (cantidad, digitos) VALUES ($1::int, $2::int) "
+        "RETURNING id, cantidad, digitos), "
+        "o AS (INSERT INTO cola (solicitud_id, cantidad, digitos) "
+        "SELECT id, cantidad, digitos FROM s) "
+        "SELECT id FROM s" :
+        "WITH s AS (INSERT INTO solicitudes (cantidad, digitos) VALUES ($1::int, $2::int) "
+        "RETURNING id, cantidad, digitos), "
+        "o AS (INSERT INTO outbox (solicitud_id, cantidad, digitos) "
+        "SELECT id, cantidad, digitos FROM s) "
+        "SELECT id FROM s",
         2, NULL, paramValues, NULL, NULL, 0);
     
-    if (PQresultStatus(res) != PGRES_TUPLES_OK) { 
-        fprintf(stderr,"DB error: %s\n", PQerrorMessage(c)); 
+    if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1) { 
+        log_write(LOG_ERROR, "[db] Error: %s\n", PQerrorMessage(c)); 
         PQclear(res); 
-        PQexec(c,"ROLLBACK"); 
         return -1; 
     }
     
@@ -93,68 +117,79 @@ int db_create_solicitud_and_enqueue(char *out_id, int cantidad, int digitos) {
     strncpy(out_id, id, 37);
     out_id[36] = '\0';
     PQclear(res);
-
-    res = PQexec(c, "COMMIT");
-    PQclear(res);
-
-    if (redis_global) {
-        char job_str[256];
-        snprintf(job_str, sizeof(job_str), "%s:%d:%d", out_id, cantidad, digitos);
-        redisReply *reply = redisCommand(redis_global, "LPUSH primes:queue %s", job_str);
-        if (!reply) {
-            fprintf(stderr, "Redis LPUSH error\n");
-            return -1;
-        }
-        freeReplyObject(reply);
-    }
-
-    rc = 0;
-    return rc;
+    return 0;
 }
 
-
-int db_fetch_job_for_worker(char *out_job_id, char *out_solicitud_id, int *out_cantidad, int *out_digitos) {
-    int rc = -1;
-    PGconn *c = get_conn();
-    if (!c) return -1;
-
+// Mueve hasta "max" filas del outbox a Redis: las borra dentro de una
+// transaccion, siembra el hash de progreso y encola todo en un pipeline, y
+// confirma solo si Redis respondio cada comando. Devuelve cuantas movio, o -1
+// (en ese caso las filas siguen en el outbox para el proximo intento).
+int db_outbox_relay_conn(PGconn *c, struct redis_client *rc, int max) {
+    uint64_t t0 = trace_now_ns();
     PGresult *res = PQexec(c, "BEGIN");
     if (PQresultStatus(res) != PGRES_COMMAND_OK) { PQclear(res); return -1; }
     PQclear(res);
 
-    PGresult *r = PQexec(c,
-        "SELECT id::text, solicitud_id::text, cantidad, digitos FROM cola WHERE procesado = FALSE FOR UPDATE SKIP LOCKED LIMIT 1");
-    if (PQresultStatus(r) != PGRES_TUPLES_OK) { PQclear(r); PQexec(c,"ROLLBACK"); return -1; }
-    if (PQntuples(r) == 0) {
-        PQclear(r);
-        PQexec(c, "ROLLBACK");
-        return 1;
+    char max_str[32];
+    snprintf(max_str, sizeof(max_str), "%d", max);
+    const char *paramValues[1] = { max_str };
+    res = PQexecParams(c,
+        "DELETE FROM outbox WHERE id IN ("
+        "SELECT id FROM outbox ORDER BY id LIMIT $1::int FOR UPDATE SKIP LOCKED) "
+        "RETURNING solicitud_id, cantidad, digitos, (EXTRACT(EPOCH FROM creado_en) * 1000)::bigint",
+        1, NULL, paramValues, NULL, NULL, 0);
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        log_write(LOG_ERROR, "[db] Error: %s\n", PQerrorMessage(c));
+        PQclear(res);
+        PQclear(PQexec(c, "ROLLBACK"));
+        return -1;
     }
-    const char *job_id = PQgetvalue(r,0,0);
-    const char *sol_id = PQgetvalue(r,0,1);
-    int cantidad = atoi(PQgetvalue(r,0,2));
-    int digitos = atoi(PQgetvalue(r,0,3));
-    strncpy(out_job_id, job_id, 37);
-    out_job_id[36] = '\0';
-    strncpy(out_solicitud_id, sol_id, 37);
-    out_solicitud_id[36] = '\0';
-    *out_cantidad = cantidad;
-    *out_digitos = digitos;
-    PQclear(r);
 
-    const char *paramValues[1] = { out_job_id };
-    PGresult *u = PQexecParams(c,
-        "UPDATE cola SET procesado = TRUE WHERE id = $1::uuid",
-        1, NULL, paramValues, NULL, NULL, 0);
-    if (PQresultStatus(u) != PGRES_COMMAND_OK) { fprintf(stderr,"DB error: %s\n", PQerrorMessage(c)); PQclear(u); PQexec(c,"ROLLBACK"); return -1; }
-    PQclear(u);
+    int n = PQntuples(res);
+    int ok = 1, sent = 0;
+    for (int i = 0; i < n && ok; ++i) {
+        const char *id = PQgetvalue(res, i, 0);
+        int cantidad = atoi(PQgetvalue(res, i, 1));
+        int digitos = atoi(PQgetvalue(res, i, 2));
+        long long creado_ms = atoll(PQgetvalue(res, i, 3));
+        char status_key[96];
+        snprintf(status_key, sizeof(status_key), STATUS_KEY_FMT, id);
+        ok = redis_client_append(rc, "HSET %s cantidad %d digitos %d generados 0",
+                status_key, cantidad, digitos) == 0 &&
+             redis_client_append(rc, "EXPIRE %s %d", status_key, STATUS_TTL_SECONDS) == 0 &&
+             queue_append_push(rc, id, cantidad, digitos, creado_ms) == 0;
+        if (ok) sent += 3;
+    }
+    for (int i = 0; i < sent && ok; ++i) {
+        redisReply *reply = redis_client_get_reply(rc);
+        if (!reply) { ok = 0; break; }
+        if (reply->type == REDIS_REPLY_ERROR) {
+            log_write(LOG_ERROR, "[db] Redis relay error: %s\n", reply->str);
+            ok = 0;
+        }
+        freeReplyObject(reply);
+    }
+    redis_client_discard(rc);
+    // Un span por solicitud: del inicio del lote hasta que Redis confirmo el encolado
+    if (trace_enabled()) {
+        uint64_t t1 = trace_now_ns();
+        struct span_attr attrs[] = { { "batch.size", n }, { "ok", ok } };
+        for (int i = 0; i < n; ++i) {
+            char trace_id[TRACE_ID_LEN + 1], root[SPAN_ID_LEN + 1];
+            trace_id_from_uuid(PQgetvalue(res, i, 0), trace_id);
+            trace_root_span_id(trace_id, root);
+            trace_span(trace_id, NULL, root, "outbox.relay", t0, t1, attrs, 2);
+        }
+    }
+    PQclear(res);
 
-    PGresult *cm = PQexec(c, "COMMIT");
-    PQclear(cm);
-    rc = 0;
-    return rc;
+    res = PQexec(c, ok ? "COMMIT" : "ROLLBACK");
+    if (ok && PQresultStatus(res) != PGRES_COMMAND_OK) ok = 0;
+    PQclear(res);
+    return ok ? n : -1;
 }
 
+
 int db_mark_job_done(const char *job_id) {
     PGconn *c = get_conn();
     if (!c) return -1;
@@ -182,7 +217,7 @@ int db_insert_result(const char *solicitud_id, const char *primo) {
             rc = -2;
             return rc;
         }
-        fprintf(stderr, "db_insert_result error: %s\n", PQerrorMessage(c));
+        log_write(LOG_ERROR, "[db] db_insert_result error: %s\n", PQerrorMessage(c));
         PQclear(r);
         return -1;
     }
@@ -203,6 +238,7 @@ int db_inc_generado(const char *solicitud_id) {
 }
 
 int db_get_status(const char *solicitud_id, int *cantidad, int *digitos, int *generados) {
+    if (backend == DB_MEMORY) return memstore_get_status(solicitud_id, cantidad, digitos, generados);
     PGconn *c = get_conn();
     if (!c) return -1;
     const char *paramValues[1] = { solicitud_id };
@@ -223,7 +259,7 @@ char ** db_get_results(const char *solicitud_id, int *count) {
     PGconn *c = get_conn();
     if (!c) { *count = -1; return NULL; }
     PGresult *r = PQexecParams(c,
-        "SELECT primo FROM resultados WHERE solicitud_id = $1::uuid",
+        "SELECT primo FROM resultados WHERE solicitud_id = $1::uuid ORDER BY length(primo), primo",
         1, NULL, paramValues, NULL, NULL, 0);
     if (PQresultStatus(r) != PGRES_TUPLES_OK) { PQclear(r); *count = -1; return NULL; }
     int n = PQntuples(r);
@@ -234,50 +270,61 @@ char ** db_get_results(const char *solicitud_id, int *count) {
     return arr;
 }
 
-void db_free_results(char **arr, int count) {
-    for (int i=0;i<count;++i) free(arr[i]);
-    free(arr);
+long long db_count_pending_jobs(void) {
+    PGconn *c = get_conn();
+    if (!c) return -1;
+    PGresult *r = PQexec(c, "SELECT count(*) FROM cola WHERE procesado = FALSE");
+    long long n = -1;
+    if (PQresultStatus(r) == PGRES_TUPLES_OK && PQntuples(r) == 1) n = atoll(PQgetvalue(r, 0, 0));
+    PQclear(r);
+    return n;
 }
 
-int db_fetch_job_for_worker_conn(PGconn *c, char *out_job_id, char *out_solicitud_id, int *out_cantidad, int *out_digitos) {
+int db_pending_primes(double primes_by_digits[21]) {
+    memset(primes_by_digits, 0, 21 * sizeof(double));
+    if (backend == DB_MEMORY) {
+        memstore_pending_primes(primes_by_digits);
+        return 0;
+    }
+    PGconn *c = get_conn();
     if (!c) return -1;
-    int rc = -1;
-
-    PGresult *res = PQexec(c, "BEGIN");
-    if (PQresultStatus(res) != PGRES_COMMAND_OK) { PQclear(res); return -1; }
-    PQclear(res);
-
     PGresult *r = PQexec(c,
-        "SELECT id::text, solicitud_id::text, cantidad, digitos FROM cola WHERE procesado = FALSE FOR UPDATE SKIP LOCKED LIMIT 1");
-    if (PQresultStatus(r) != PGRES_TUPLES_OK) { PQclear(r); PQexec(c,"ROLLBACK"); return -1; }
-    if (PQntuples(r) == 0) {
-        PQclear(r);
-        PQexec(c, "ROLLBACK");
-        return 1;
+        "SELECT digitos, sum(cantidad - generados) FROM solicitudes "
+        "WHERE generados < cantidad GROUP BY digitos");
+    if (PQresultStatus(r) != PGRES_TUPLES_OK) { PQclear(r); return -1; }
+    for (int i = 0; i < PQntuples(r); ++i) {
+        int d = atoi(PQgetvalue(r, i, 0));
+        if (d >= 0 && d <= 20) primes_by_digits[d] += atof(PQgetvalue(r, i, 1));
     }
-    const char *job_id = PQgetvalue(r,0,0);
-    const char *sol_id = PQgetvalue(r,0,1);
-    int cantidad = atoi(PQgetvalue(r,0,2));
-    int digitos = atoi(PQgetvalue(r,0,3));
-    strncpy(out_job_id, job_id, 37);
-    out_job_id[36] = '\0';
-    strncpy(out_solicitud_id, sol_id, 37);
-    out_solicitud_id[36] = '\0';
-    *out_cantidad = cantidad;
-    *out_digitos = digitos;
     PQclear(r);
+    return 0;
+}
 
-    const char *paramValues[1] = { out_job_id };
-    PGresult *u = PQexecParams(c,
-        "UPDATE cola SET procesado = TRUE WHERE id = $1::uuid",
-        1, NULL, paramValues, NULL, NULL, 0);
-    if (PQresultStatus(u) != PGRES_COMMAND_OK) { fprintf(stderr,"DB error: %s\n", PQerrorMessage(c)); PQclear(u); PQexec(c,"ROLLBACK"); return -1; }
-    PQclear(u);
+// Pagina por clave en orden numerico: primo es TEXT y no todos tienen los mismos
+// digitos, asi que se compara (length(primo), primo), igual que el indice.
+char ** db_get_results_page(const char *solicitud_id, const char *after, int limit, int *count) {
+    char limit_s[16];
+    snprintf(limit_s, sizeof(limit_s), "%d", limit);
+    const char *paramValues[3] = { solicitud_id, after ? after : "", limit_s };
+    PGconn *c = get_conn();
+    if (!c) { *count = -1; return NULL; }
+    PGresult *r = PQexecParams(c,
+        "SELECT primo FROM resultados WHERE solicitud_id = $1::uuid "
+        "AND (length(primo), primo) > (length($2), $2) "
+        "ORDER BY length(primo), primo LIMIT $3::int",
+        3, NULL, paramValues, NULL, NULL, 0);
+    if (PQresultStatus(r) != PGRES_TUPLES_OK) { PQclear(r); *count = -1; return NULL; }
+    int n = PQntuples(r);
+    char **arr = malloc(sizeof(char*) * (n ? n : 1));
+    for (int i=0;i<n;++i) arr[i] = strdup(PQgetvalue(r,i,0));
+    PQclear(r);
+    *count = n;
+    return arr;
+}
 
-    PGresult *cm = PQexec(c, "COMMIT");
-    PQclear(cm);
-    rc = 0;
-    return rc;
+void db_free_results(char **arr, int count) {
+    for (int i=0;i<count;++i) free(arr[i]);
+    free(arr);
 }
 
 int db_mark_job_done_conn(PGconn *c, const char *job_id) {
@@ -293,6 +340,7 @@ int db_mark_job_done_conn(PGconn *c, const char *job_id) {
 
 int db_insert_result_conn(PGconn *c, const char *solicitud_id, const char *primo) {
     if (!c) return -1;
+    if (c == MEMORY_CONN) return memstore_insert_result(solicitud_id, primo);
     int rc = -1;
     const char *paramValues[2] = { solicitud_id, primo };
     PGresult *r = PQexecParams(c,
@@ -305,7 +353,7 @@ int db_insert_result_conn(PGconn *c, const char *solicitud_id, const char *primo
             rc = -2;
             return rc;
         }
-        fprintf(stderr, "db_insert_result_conn error: %s\n", PQerrorMessage(c));
+        log_write(LOG_ERROR, "[db] db_insert_result_conn error: %s\n", PQerrorMessage(c));
         PQclear(r);
         return -1;
     }
@@ -323,3 +371,94 @@ int db_inc_generado_conn(PGconn *c, const char *solicitud_id) {
     PQclear(r);
     return 0;
 }
+
+int db_inc_generado_progress_conn(PGconn *c, const char *solicitud_id, int *out_generados, int *out_cantidad) {
+    if (!c) return -1;
+    if (c == MEMORY_CONN) return memstore_inc_generado(solicitud_id, out_generados, out_cantidad);
+    const char *paramValues[1] = { solicitud_id };
+    PGresult *r = PQexecParams(c,
+        "UPDATE solicitudes SET generados = generados + 1 WHERE id = $1::uuid RETURNING generados, cantidad",
+        1, NULL, paramValues, NULL, NULL, 0);
+    if (PQresultStatus(r) != PGRES_TUPLES_OK) { PQclear(r); return -1; }
+    if (PQntuples(r) == 0) { PQclear(r); return -2; }
+    *out_generados = atoi(PQgetvalue(r,0,0));
+    *out_cantidad = atoi(PQgetvalue(r,0,1));
+    PQclear(r);
+    return 0;
+}
+
+int db_notify_done_conn(PGconn *c, const char *solicitud_id) {
+    if (!c) return -1;
+    if (c == MEMORY_CONN) return 0;
+    const char *paramValues[1] = { solicitud_id };
+    PGresult *r = PQexecParams(c, "SELECT pg_notify('" DONE_CHANNEL "', $1)",
+        1, NULL, paramValues, NULL, NULL, 0);
+    if (PQresultStatus(r) != PGRES_TUPLES_OK) { PQclear(r); return -1; }
+    PQclear(r);
+    return 0;
+}
+
+// Reclama hasta "max" jobs en una sola sentencia: pendientes o con el lease
+// vencido (su worker dejo de renovarlo). El id de la fila queda en job->ref.
+int db_claim_jobs_conn(PGconn *c, const char *worker, int lease_seconds, struct job *jobs, int max) {
+    if (!c) return -1;
+    char lease_str[32], max_str[32];
+    snprintf(lease_str, sizeof(lease_str), "%d", lease_seconds);
+    snprintf(max_str, sizeof(max_str), "%d", max);
+    const char *paramValues[3] = { worker, lease_str, max_str };
+    PGresult *r = PQexecParams(c,
+        "UPDATE cola SET procesado = TRUE, worker = $1, "
+        "lease_hasta = NOW() + make_interval(secs => $2::int) "
+        "WHERE id IN (SELECT id FROM cola WHERE procesado = FALSE OR lease_hasta < NOW() "
+        "ORDER BY creado_en LIMIT $3::int FOR UPDATE SKIP LOCKED) "
+        "RETURNING id::text, solicitud_id::text, cantidad, digitos, "
+        "(EXTRACT(EPOCH FROM creado_en) * 1000)::bigint",
+        3, NULL, paramValues, NULL, NULL, 0);
+    if (PQresultStatus(r) != PGRES_TUPLES_OK) {
+        log_write(LOG_ERROR, "[db] db_claim_jobs_conn error: %s\n", PQerrorMessage(c));
+        PQclear(r);
+        return -1;
+    }
+    int n = PQntuples(r);
+    for (int i = 0; i < n; ++i) {
+        struct job *job = &jobs[i];
+        snprintf(job->ref, sizeof(job->ref), "%s", PQgetvalue(r, i, 0));
+        snprintf(job->solicitud_id, sizeof(job->solicitud_id), "%s", PQgetvalue(r, i, 1));
+        job->cantidad = atoi(PQgetvalue(r, i, 2));
+        job->digitos = atoi(PQgetvalue(r, i, 3));
+        job->enqueued_ms = atoll(PQgetvalue(r, i, 4));
+        trace_id_from_uuid(job->solicitud_id, job->trace_id);
+        job->job_class = queue_job_class(job->cantidad, job->digitos);
+    }
+    PQclear(r);
+    return n;
+}
+
+int db_renew_leases_conn(PGconn *c, const char *worker, int lease_seconds) {
+    if (!c) return -1;
+    char lease_str[32];
+    snprintf(lease_str, sizeof(lease_str), "%d", lease_seconds);
+    const char *paramValues[2] = { worker, lease_str };
+    PGresult *r = PQexecParams(c,
+        "UPDATE cola SET lease_hasta = NOW() + make_interval(secs => $2::int) "
+        "WHERE worker = $1 AND procesado = TRUE",
+        2, NULL, paramValues, NULL, NULL, 0);
+    if (PQresultStatus(r) != PGRES_COMMAND_OK) { PQclear(r); return -1; }
+    PQclear(r);
+    return 0;
+}
+
+// Devuelve un job reclamado a pendiente con "cantidad" primos por generar.
+int db_release_job_conn(PGconn *c, const char *job_id, int cantidad) {
+    if (!c) return -1;
+    char cant_str[32];
+    snprintf(cant_str, sizeof(cant_str), "%d", cantidad);
+    const char *paramValues[2] = { job_id, cant_str };
+    PGresult *r = PQexecParams(c,
+        "UPDATE cola SET procesado = FALSE, worker = NULL, lease_hasta = NULL, "
+        "cantidad = $2::int WHERE id = $1::uuid",
+        2, NULL, paramValues, NULL, NULL, 0);
+    if (PQresultStatus(r) != PGRES_COMMAND_OK) { PQclear(r); return -1; }
+    PQclear(r);
+    return 0;
+}
@@ -0,0 +1,201 @@
+#define _POSIX_C_SOURCE 200809L
+#include "log.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#define RING_SLOTS 4096             // potencia de 2
+#define MSG_MAX 480
+#define FLUSH_IDLE_MS 5
+#define DEFAULT_SAMPLE_EVERY 100
+#define DEFAULT_SAMPLE_MAX_PER_S 50
+
+// Ranura del ring (cola acotada de Vyukov): "seq" indica de quien es el turno.
+struct slot {
+    uint64_t seq;
+    int level;
+    struct timespec ts;
+    char msg[MSG_MAX];
+};
+
+static struct slot ring[RING_SLOTS];
+static uint64_t tail = 0;           // proxima ranura a reservar (productores)
+static uint64_t head = 0;           // proxima ranura a volcar (solo el hilo)
+static uint64_t dropped = 0;
+static int min_level = LOG_INFO;
+static int json = 0;
+static int sample_every = DEFAULT_SAMPLE_EVERY;
+static int sample_max_per_s = DEFAULT_SAMPLE_MAX_PER_S;
+static volatile int running = 0;
+static pthread_t flusher;
+
+static __thread unsigned long sample_n = 0;
+static __thread time_t sample_sec = 0;
+static __thread int sample_in_sec = 0;
+
+static const char *level_names[] = { "error", "warn", "info", "debug" };
+
+void log_configure(const char *level_name) {
+    if (!level_name) return;
+    if (strcasecmp(level_name, "error") == 0) min_level = LOG_ERROR;
+    else if (strcasecmp(level_name, "warn") == 0) min_level = LOG_WARN;
+    else if (strcasecmp(level_name, "debug") == 0) min_level = LOG_DEBUG;
+    else min_level = LOG_INFO;
+}
+
+int log_enabled(int level) {
+    return level <= min_level;
+}
+
+// "[api] Listening on ..." -> component "api", message "Listening on ...".
+static void json_line(FILE *f, const struct slot *s) {
+    const char *msg = s->msg;
+    char component[32] = "";
+    if (msg[0] == '[') {
+        const char *end = strchr(msg, ']');
+        if (end && (size_t)(end - msg) < sizeof(component)) {
+            memcpy(component, msg + 1, (size_t)(end - msg - 1));
+            component[end - msg - 1] = '\0';
+            msg = end + 1;
+            while (*msg == ' ') ++msg;
+        }
+    }
+    struct tm tm;
+    gmtime_r(&s->ts.tv_sec, &tm);
+    char when[32];
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S", &tm);
+    fprintf(f, "{\"ts\":\"%s.%03ldZ\",\"level\":\"%s\",\"component\":\"%s\",\"msg\":\"",
+        when, s->ts.tv_nsec / 1000000, level_names[s->level], component);
+    for (const char *p = msg; *p; ++p) {
+        if (*p == '\n' && p[1] == '\0') break;
+        if (*p == '"' || *p == '\\') fprintf(f, "\\%c", *p);
+        else if ((unsigned char)*p < 0x20) fprintf(f, "\\u%04x", (unsigned char)*p);
+        else fputc(*p, f);
+    }
+    fputs("\"}\n", f);
+}
+
+static void emit(const struct slot *s) {
+    FILE *f = s->level <= LOG_WARN ? stderr : stdout;
+    if (json) json_line(f, s);
+    else fputs(s->msg, f);
+}
+
+// Formatea en "s"; si no entra se corta conservando el salto de linea final.
+static void format_msg(struct slot *s, const char *fmt, va_list ap) {
+    int n = vsnprintf(s->msg, sizeof(s->msg), fmt, ap);
+    if (n >= (int)sizeof(s->msg)) s->msg[sizeof(s->msg) - 2] = '\n';
+}
+
+// Devuelve cuantas lineas volco.
+static int drain(void) {
+    int n = 0;
+    for (;;) {
+        struct slot *s = &ring[head & (RING_SLOTS - 1)];
+        if (__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) != head + 1) break;
+        emit(s);
+        __atomic_store_n(&s->seq, head + RING_SLOTS, __ATOMIC_RELEASE);
+        head++;
+        n++;
+    }
+    if (n) {
+        fflush(stdout);
+        fflush(stderr);
+    }
+    return n;
+}
+
+static void *flush_thread(void *arg) {
+    (void)arg;
+    uint64_t reported = 0;
+    while (running) {
+        if (drain() == 0) {
+            struct timespec ts = { 0, FLUSH_IDLE_MS * 1000000L };
+            nanosleep(&ts, NULL);
+        }
+        uint64_t d = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+        if (d != reported) {
+            fprintf(stderr, "[log] %llu lines dropped (buffer full)\n", (unsigned long long)(d - reported));
+            reported = d;
+        }
+    }
+    drain();
+    return NULL;
+}
+
+void log_init(void) {
+    log_configure(getenv("LOG_LEVEL"));
+    const char *fmt = getenv("LOG_FORMAT");
+    json = fmt && strcasecmp(fmt, "json") == 0;
+    const char *every = getenv("LOG_SAMPLE");
+    if (every) sample_every = atoi(every) > 0 ? atoi(every) : 1;
+    const char *max = getenv("LOG_SAMPLE_MAX");
+    if (max) sample_max_per_s = atoi(max) > 0 ? atoi(max) : 1;
+    for (uint64_t i = 0; i < RING_SLOTS; ++i) ring[i].seq = i;
+    running = 1;
+    if (pthread_create(&flusher, NULL, flush_thread, NULL) != 0) running = 0;
+    else atexit(log_shutdown);
+}
+
+void log_shutdown(void) {
+    if (!running) return;
+    running = 0;
+    pthread_join(flusher, NULL);
+}
+
+void log_write(int level, const char *fmt, ...) {
+    if (!log_enabled(level)) return;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    va_list ap;
+    va_start(ap, fmt);
+    if (!running) {
+        struct slot s = { .level = level, .ts = now };
+        format_msg(&s, fmt, ap);
+        va_end(ap);
+        emit(&s);
+        return;
+    }
+
+    uint64_t pos = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+    struct slot *s;
+    for (;;) {
+        s = &ring[pos & (RING_SLOTS - 1)];
+        uint64_t seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+        } else if (diff < 0) {
+            // Lleno: se pierde la linea en vez de esperar al hilo de volcado
+            __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+            va_end(ap);
+            return;
+        } else {
+            pos = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+        }
+    }
+    s->level = level;
+    s->ts = now;
+    format_msg(s, fmt, ap);
+    va_end(ap);
+    __atomic_store_n(&s->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+int log_sampled(void) {
+    if (sample_n++ % (unsigned long)sample_every != 0) return 0;
+    time_t sec = time(NULL);
+    if (sec != sample_sec) {
+        sample_sec = sec;
+        sample_in_sec = 0;
+    }
+    return sample_in_sec++ < sample_max_per_s;
+}
+
+unsigned long long log_dropped(void) {
+    return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
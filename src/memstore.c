@@ -0,0 +1,148 @@
+#define _POSIX_C_SOURCE 200809L
+#include "memstore.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ID_PREFIX "00000000-0000-4000-8000-"
+#define SET_INITIAL 4096
+
+struct solicitud {
+    int cantidad, digitos, generados;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct solicitud *rows = NULL;
+static size_t n_rows = 0, cap_rows = 0;
+
+// Conjunto de primos con direccionamiento abierto; 0 marca un hueco libre.
+static uint64_t *set = NULL;
+static size_t set_cap = 0, set_used = 0;
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static void set_insert_slot(uint64_t *slots, size_t cap, uint64_t v) {
+    size_t i = mix64(v) & (cap - 1);
+    while (slots[i]) i = (i + 1) & (cap - 1);
+    slots[i] = v;
+}
+
+static int set_grow(void) {
+    size_t cap = set_cap ? set_cap * 2 : SET_INITIAL;
+    uint64_t *slots = calloc(cap, sizeof(uint64_t));
+    if (!slots) return -1;
+    for (size_t i = 0; i < set_cap; ++i) {
+        if (set[i]) set_insert_slot(slots, cap, set[i]);
+    }
+    free(set);
+    set = slots;
+    set_cap = cap;
+    return 0;
+}
+
+// Fila de la solicitud o NULL; llamar con el lock tomado.
+static struct solicitud *row_of(const char *solicitud_id) {
+    if (strncmp(solicitud_id, ID_PREFIX, sizeof(ID_PREFIX) - 1) != 0) return NULL;
+    size_t i = strtoull(solicitud_id + sizeof(ID_PREFIX) - 1, NULL, 16);
+    return i < n_rows ? &rows[i] : NULL;
+}
+
+int memstore_create(char *out_id, int cantidad, int digitos) {
+    pthread_mutex_lock(&lock);
+    if (n_rows == cap_rows) {
+        size_t cap = cap_rows ? cap_rows * 2 : 256;
+        struct solicitud *r = realloc(rows, cap * sizeof(*r));
+        if (!r) {
+            pthread_mutex_unlock(&lock);
+            return -1;
+        }
+        rows = r;
+        cap_rows = cap;
+    }
+    struct solicitud *s = &rows[n_rows];
+    s->cantidad = cantidad;
+    s->digitos = digitos;
+    s->generados = 0;
+    snprintf(out_id, 37, ID_PREFIX "%012zx", n_rows);
+    n_rows++;
+    pthread_mutex_unlock(&lock);
+    return 0;
+}
+
+int memstore_get_status(const char *solicitud_id, int *cantidad, int *digitos, int *generados) {
+    pthread_mutex_lock(&lock);
+    struct solicitud *s = row_of(solicitud_id);
+    if (s) {
+        *cantidad = s->cantidad;
+        *digitos = s->digitos;
+        *generados = s->generados;
+    }
+    pthread_mutex_unlock(&lock);
+    return s ? 0 : -2;
+}
+
+int memstore_insert_result(const char *solicitud_id, const char *primo) {
+    uint64_t v = strtoull(primo, NULL, 10);
+    if (v == 0) return -1;
+    int rc = 0;
+    pthread_mutex_lock(&lock);
+    if (!row_of(solicitud_id) || ((set_used + 1) * 2 > set_cap && set_grow() != 0)) {
+        rc = -1;
+    } else {
+        size_t i = mix64(v) & (set_cap - 1);
+        while (set[i] && set[i] != v) i = (i + 1) & (set_cap - 1);
+        if (set[i]) {
+            rc = -2;
+        } else {
+            set[i] = v;
+            set_used++;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return rc;
+}
+
+int memstore_inc_generado(const char *solicitud_id, int *out_generados, int *out_cantidad) {
+    pthread_mutex_lock(&lock);
+    struct solicitud *s = row_of(solicitud_id);
+    if (s) {
+        *out_generados = ++s->generados;
+        *out_cantidad = s->cantidad;
+    }
+    pthread_mutex_unlock(&lock);
+    return s ? 0 : -2;
+}
+
+void memstore_pending_primes(double primes_by_digits[21]) {
+    pthread_mutex_lock(&lock);
+    for (size_t i = 0; i < n_rows; ++i) {
+        const struct solicitud *s = &rows[i];
+        if (s->generados < s->cantidad && s->digitos >= 0 && s->digitos <= 20)
+            primes_by_digits[s->digitos] += s->cantidad - s->generados;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+long long memstore_results(void) {
+    pthread_mutex_lock(&lock);
+    long long n = (long long)set_used;
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+void memstore_free(void) {
+    pthread_mutex_lock(&lock);
+    free(rows);
+    free(set);
+    rows = NULL;
+    set = NULL;
+    n_rows = cap_rows = set_cap = set_used = 0;
+    pthread_mutex_unlock(&lock);
+}
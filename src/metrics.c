@@ -0,0 +1,224 @@
+#define _POSIX_C_SOURCE 200809L
+#include "metrics.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_COUNTERS 256
+#define MAX_HISTOGRAMS 48
+#define MAX_GAUGES 32
+
+enum metric_kind { KIND_COUNTER, KIND_HISTOGRAM, KIND_GAUGE };
+
+struct metric_desc {
+    int kind;
+    int slot;                   // indice dentro de su arreglo en el shard
+    char name[64];
+    char help[128];
+    char labels[96];
+    metrics_gauge_fn fn;
+    void *arg;
+};
+
+struct hist {
+    uint64_t buckets[METRICS_HIST_BUCKETS];
+    uint64_t count;
+    uint64_t sum_us;
+};
+
+// Un shard por hilo; solo su hilo lo escribe.
+struct shard {
+    uint64_t counters[MAX_COUNTERS];
+    struct hist hists[MAX_HISTOGRAMS];
+    struct shard *next;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct metric_desc descs[MAX_COUNTERS + MAX_HISTOGRAMS + MAX_GAUGES];
+static int n_descs = 0, n_counters = 0, n_hists = 0, n_gauges = 0;
+static struct shard *shards = NULL;
+static __thread struct shard *my_shard = NULL;
+
+// Los ids devueltos codifican tipo y slot para no consultar descs en el camino caliente
+#define ID_HIST_BASE 0x10000
+
+static int add_desc(int kind, int slot, const char *name, const char *help, const char *labels) {
+    struct metric_desc *d = &descs[n_descs++];
+    d->kind = kind;
+    d->slot = slot;
+    snprintf(d->name, sizeof(d->name), "%s", name);
+    snprintf(d->help, sizeof(d->help), "%s", help ? help : "");
+    snprintf(d->labels, sizeof(d->labels), "%s", labels ? labels : "");
+    return slot;
+}
+
+int metrics_counter(const char *name, const char *help, const char *labels) {
+    pthread_mutex_lock(&lock);
+    int id = n_counters < MAX_COUNTERS ? add_desc(KIND_COUNTER, n_counters++, name, help, labels) : -1;
+    pthread_mutex_unlock(&lock);
+    return id;
+}
+
+int metrics_histogram(const char *name, const char *help, const char *labels) {
+    pthread_mutex_lock(&lock);
+    int id = n_hists < MAX_HISTOGRAMS
+        ? ID_HIST_BASE + add_desc(KIND_HISTOGRAM, n_hists++, name, help, labels) : -1;
+    pthread_mutex_unlock(&lock);
+    return id;
+}
+
+int metrics_gauge(const char *name, const char *help, const char *labels,
+                  metrics_gauge_fn fn, void *arg) {
+    pthread_mutex_lock(&lock);
+    int id = -1;
+    if (n_gauges < MAX_GAUGES) {
+        id = add_desc(KIND_GAUGE, n_gauges++, name, help, labels);
+        descs[n_descs - 1].fn = fn;
+        descs[n_descs - 1].arg = arg;
+    }
+    pthread_mutex_unlock(&lock);
+    return id;
+}
+
+static struct shard *get_shard(void) {
+    if (my_shard) return my_shard;
+    struct shard *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    pthread_mutex_lock(&lock);
+    s->next = shards;
+    shards = s;
+    pthread_mutex_unlock(&lock);
+    my_shard = s;
+    return s;
+}
+
+void metrics_add(int id, uint64_t n) {
+    if (id < 0 || id >= MAX_COUNTERS) return;
+    struct shard *s = get_shard();
+    if (s) __atomic_fetch_add(&s->counters[id], n, __ATOMIC_RELAXED);
+}
+
+void metrics_inc(int id) {
+    metrics_add(id, 1);
+}
+
+// -1 si supera el ultimo bucket finito: solo cuenta en +Inf y en _sum.
+static int bucket_of(uint64_t us) {
+    if (us < (1u << METRICS_HIST_SUB_BITS)) return (int)us;
+    int e = 63 - __builtin_clzll(us);
+    if (e >= METRICS_HIST_MAX_EXP) return -1;
+    int sub = (int)(us >> (e - METRICS_HIST_SUB_BITS)) & ((1 << METRICS_HIST_SUB_BITS) - 1);
+    return ((e - METRICS_HIST_SUB_BITS + 1) << METRICS_HIST_SUB_BITS) + sub;
+}
+
+// Mayor valor (us) que cae en el bucket "b".
+static uint64_t bucket_upper(int b) {
+    if (b < (1 << METRICS_HIST_SUB_BITS)) return (uint64_t)b;
+    int e = (b >> METRICS_HIST_SUB_BITS) + METRICS_HIST_SUB_BITS - 1;
+    uint64_t sub = (uint64_t)(b & ((1 << METRICS_HIST_SUB_BITS) - 1));
+    uint64_t width = 1ULL << (e - METRICS_HIST_SUB_BITS);
+    return (((1ULL << METRICS_HIST_SUB_BITS) + sub) << (e - METRICS_HIST_SUB_BITS)) + width - 1;
+}
+
+void metrics_observe_us(int id, uint64_t us) {
+    int slot = id - ID_HIST_BASE;
+    if (slot < 0 || slot >= MAX_HISTOGRAMS) return;
+    struct shard *s = get_shard();
+    if (!s) return;
+    struct hist *h = &s->hists[slot];
+    int b = bucket_of(us);
+    if (b >= 0) __atomic_fetch_add(&h->buckets[b], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum_us, us, __ATOMIC_RELAXED);
+}
+
+uint64_t metrics_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+struct buf {
+    char *p;
+    size_t len, cap;
+};
+
+__attribute__((format(printf, 2, 3)))
+static void bprintf(struct buf *b, const char *fmt, ...) {
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = b->p ? vsnprintf(b->p + b->len, b->cap - b->len, fmt, ap) : -1;
+        va_end(ap);
+        if (n >= 0 && b->len + (size_t)n < b->cap) {
+            b->len += (size_t)n;
+            return;
+        }
+        size_t cap = b->cap ? b->cap * 2 : 16384;
+        char *p = realloc(b->p, cap);
+        if (!p) return;
+        b->p = p;
+        b->cap = cap;
+    }
+}
+
+// HELP/TYPE una vez por familia: la primera serie con ese nombre.
+static void family_header(struct buf *b, int i, const char *type) {
+    for (int j = 0; j < i; ++j) {
+        if (strcmp(descs[j].name, descs[i].name) == 0) return;
+    }
+    bprintf(b, "# HELP %s %s\n# TYPE %s %s\n", descs[i].name, descs[i].help, descs[i].name, type);
+}
+
+size_t metrics_render(char **out) {
+    struct buf b = { 0 };
+    struct hist sum;
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < n_descs; ++i) {
+        const struct metric_desc *d = &descs[i];
+        const char *sep = d->labels[0] ? "," : "";
+        // Sin etiquetas la serie va sin llaves
+        char lb[sizeof(d->labels) + 2] = "";
+        if (d->labels[0]) snprintf(lb, sizeof(lb), "{%s}", d->labels);
+        if (d->kind == KIND_COUNTER) {
+            uint64_t v = 0;
+            for (struct shard *s = shards; s; s = s->next) {
+                v += __atomic_load_n(&s->counters[d->slot], __ATOMIC_RELAXED);
+            }
+            family_header(&b, i, "counter");
+            bprintf(&b, "%s%s %llu\n", d->name, lb, (unsigned long long)v);
+        } else if (d->kind == KIND_GAUGE) {
+            family_header(&b, i, "gauge");
+            bprintf(&b, "%s%s %.17g\n", d->name, lb, d->fn ? d->fn(d->arg) : 0.0);
+        } else {
+            memset(&sum, 0, sizeof(sum));
+            for (struct shard *s = shards; s; s = s->next) {
+                const struct hist *h = &s->hists[d->slot];
+                for (int k = 0; k < METRICS_HIST_BUCKETS; ++k) {
+                    sum.buckets[k] += __atomic_load_n(&h->buckets[k], __ATOMIC_RELAXED);
+                }
+                sum.count += __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+                sum.sum_us += __atomic_load_n(&h->sum_us, __ATOMIC_RELAXED);
+            }
+            family_header(&b, i, "histogram");
+            // Cumulativos con "le" en segundos; se leen sin detener a los
+            // escritores, asi que count puede adelantarse un poco a los buckets
+            uint64_t cum = 0;
+            for (int k = 0; k < METRICS_HIST_BUCKETS; ++k) {
+                cum += sum.buckets[k];
+                bprintf(&b, "%s_bucket{%s%sle=\"%.9g\"} %llu\n", d->name, d->labels, sep,
+                    (double)bucket_upper(k) / 1e6, (unsigned long long)cum);
+            }
+            bprintf(&b, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", d->name, d->labels, sep,
+                (unsigned long long)sum.count);
+            bprintf(&b, "%s_sum%s %.6f\n", d->name, lb, (double)sum.sum_us / 1e6);
+            bprintf(&b, "%s_count%s %llu\n", d->name, lb, (unsigned long long)sum.count);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    *out = b.p;
+    return b.len;
+}
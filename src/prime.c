@@ -22,12 +22,18 @@ static inline uint64_t modpow(uint64_t a, uint64_t d, uint64_t mod) {
 }
 
 int is_probable_prime(uint64_t n) {
+    return is_probable_prime_stage(n, NULL);
+}
+
+int is_probable_prime_stage(uint64_t n, int *reached_mr) {
+    if (reached_mr) *reached_mr = 0;
     if (n < 2) return 0;
     static const uint64_t small[] = {2,3,5,7,11,13,17,19,23,29,31,37};
     for (size_t i=0;i<sizeof(small)/sizeof(small[0]);++i) {
         if (n == small[i]) return 1;
         if (n % small[i] == 0) return 0;
     }
+    if (reached_mr) *reached_mr = 1;
     uint64_t d = n - 1; int s = 0;
     while ((d & 1) == 0) { d >>= 1; s++; }
     uint64_t bases[] = {2,325,9375,28178,450775,9780504,1795265022};
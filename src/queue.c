@@ -0,0 +1,805 @@
+#define _POSIX_C_SOURCE 200809L
+#include "queue.h"
+#include "db.h"
+#include "log.h"
+#include <stdio.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#define WORKERS_KEY "primes:workers"
+#define PROCESSING_KEY_FMT "primes:processing:%s"
+#define HEARTBEAT_KEY_FMT "primes:worker:%s"
+#define REAPER_LOCK_KEY "primes:reaper:lock"
+#define HEARTBEAT_TTL 15
+#define REAPER_INTERVAL 10
+#define CLAIM_IDLE_MS (HEARTBEAT_TTL * 1000)
+#define MAX_HELD 64
+#define DEFAULT_BENCH_JOBS 200
+#define DEFAULT_BENCH_CANTIDAD 100
+#define DEFAULT_BENCH_DIGITOS 12
+
+// Costo relativo de generar un primo segun sus digitos. Un INSERT cuesta ~100;
+// con pocos digitos casi todo candidato choca con el indice unico global y
+// con muchos crecen los candidatos por primo (~1.15 * digitos) y el modmul.
+static const int digit_cost[21] = {
+    0, 0, 2000, 800, 300, 150, 120, 110, 110, 110,
+    110, 115, 120, 125, 130, 140, 150, 160, 170, 185, 200
+};
+#define SMALL_MAX_COST 5000     // ~40 primos de 12 digitos
+#define MEDIUM_MAX_COST 50000
+
+static const char *class_names[JOB_CLASSES] = { "small", "medium", "large" };
+
+static enum queue_backend backend = QUEUE_LIST;
+static PGconn *pg = NULL;
+static queue_remaining_fn remaining_fn = NULL;
+
+static char worker_id[128];
+static char processing_key[192];
+static char heartbeat_key[192];
+static time_t last_heartbeat = 0;
+static time_t last_recover = 0;
+
+static char queue_keys[JOB_CLASSES][64];
+static char stream_keys[JOB_CLASSES][64];
+static int weights[JOB_CLASSES] = { 6, 3, 1 };
+static int wrr_current[JOB_CLASSES];
+
+// Stream: entradas entregadas a este worker y aun sin XACK. Se les renueva el
+// idle con XCLAIM JUSTID para que XAUTOCLAIM no las robe mientras se procesan.
+struct held_entry {
+    char id[64];
+    int job_class;
+};
+static struct held_entry held[MAX_HELD];
+static int n_held = 0;
+
+// Stream: jobs ya entregados (y en held) que no entraron en el ultimo fetch:
+// reclamados con XAUTOCLAIM o sobrantes de un XREADGROUP multi-stream. Se
+// entregan en orden de llegada desde local_head.
+static struct job local_jobs[MAX_HELD];
+static int local_head = 0, n_local = 0;
+
+// memory: ring con los jobs sembrados; "mem_inflight" cuenta los entregados
+// que aun no volvieron por ack o requeue. El fetch lo hace el fetcher y el
+// drenado lo consulta el hilo principal, por eso el lock.
+static struct job *mem_ring = NULL;
+static int mem_cap = 0, mem_head = 0, mem_count = 0, mem_inflight = 0;
+static pthread_mutex_t mem_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mem_not_empty = PTHREAD_COND_INITIALIZER;
+
+// Mueve a processing el primer job disponible recorriendo las colas en el
+// orden dado (KEYS[1..n-1]); KEYS[n] es la lista processing del worker.
+static const char *SWEEP_SCRIPT =
+    "for i = 1, #KEYS - 1 do "
+    "  local v = redis.call('LMOVE', KEYS[i], KEYS[#KEYS], 'RIGHT', 'LEFT') "
+    "  if v then return v end "
+    "end "
+    "return false";
+
+enum queue_backend queue_configure(const char *name) {
+    if (name && strcasecmp(name, "stream") == 0) backend = QUEUE_STREAM;
+    else if (name && strcasecmp(name, "postgres") == 0) backend = QUEUE_POSTGRES;
+    else if (name && strcasecmp(name, "memory") == 0) backend = QUEUE_MEMORY;
+    else backend = QUEUE_LIST;
+    for (int i = 0; i < JOB_CLASSES; ++i) {
+        snprintf(queue_keys[i], sizeof(queue_keys[i]), QUEUE_KEY_FMT, class_names[i]);
+        snprintf(stream_keys[i], sizeof(stream_keys[i]), QUEUE_STREAM_KEY_FMT, class_names[i]);
+    }
+    const char *w = getenv("QUEUE_WEIGHTS");
+    int parsed[JOB_CLASSES];
+    if (w && sscanf(w, "%d,%d,%d", &parsed[0], &parsed[1], &parsed[2]) == JOB_CLASSES) {
+        for (int i = 0; i < JOB_CLASSES; ++i) weights[i] = parsed[i] > 0 ? parsed[i] : 1;
+    }
+    return backend;
+}
+
+enum queue_backend queue_get_backend(void) {
+    return backend;
+}
+
+const char *queue_backend_name(void) {
+    if (backend == QUEUE_POSTGRES) return "postgres";
+    if (backend == QUEUE_MEMORY) return "memory";
+    return backend == QUEUE_STREAM ? "stream" : "list";
+}
+
+int queue_job_class(int cantidad, int digitos) {
+    if (digitos < 0) digitos = 0;
+    if (digitos > 20) digitos = 20;
+    long long cost = (long long)cantidad * digit_cost[digitos];
+    if (cost <= SMALL_MAX_COST) return JOB_SMALL;
+    if (cost <= MEDIUM_MAX_COST) return JOB_MEDIUM;
+    return JOB_LARGE;
+}
+
+int queue_digit_cost(int digitos) {
+    if (digitos < 0) digitos = 0;
+    if (digitos > 20) digitos = 20;
+    return digit_cost[digitos];
+}
+
+const char *queue_class_name(int job_class) {
+    return job_class >= 0 && job_class < JOB_CLASSES ? class_names[job_class] : "unknown";
+}
+
+long long queue_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int queue_format_job(char *buf, size_t n, const char *solicitud_id, int cantidad,
+                     int digitos, long long enqueued_ms, const char *trace_id) {
+    int len = snprintf(buf, n, "%s:%d:%d:%lld:%s", solicitud_id, cantidad, digitos, enqueued_ms,
+        trace_id ? trace_id : "");
+    return (len < 0 || (size_t)len >= n) ? -1 : 0;
+}
+
+// Formato "<id>:<cantidad>:<digitos>[:<encolado_ms>[:<trace_id>]]"
+int queue_parse_job(const char *job_str, struct job *job) {
+    char solicitud_id[64];
+    char trace_id[TRACE_ID_LEN + 1] = "";
+    int cantidad, digitos;
+    long long enqueued_ms = 0;
+    int n = sscanf(job_str, "%63[^:]:%d:%d:%lld:%32[0-9a-f]", solicitud_id, &cantidad, &digitos,
+        &enqueued_ms, trace_id);
+    if (n < 3) return -1;
+    // Jobs encolados antes de que existiera el campo: el trace id sale del uuid
+    if (n < 5) trace_id_from_uuid(solicitud_id, trace_id);
+    snprintf(job->trace_id, sizeof(job->trace_id), "%s", trace_id);
+    snprintf(job->solicitud_id, sizeof(job->solicitud_id), "%s", solicitud_id);
+    job->cantidad = cantidad;
+    job->digitos = digitos;
+    job->enqueued_ms = enqueued_ms;
+    job->job_class = queue_job_class(cantidad, digitos);
+    return 0;
+}
+
+static void redis_simple(redisContext *c, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    redisReply *reply = redisvCommand(c, fmt, ap);
+    va_end(ap);
+    if (reply) freeReplyObject(reply);
+}
+
+static int append_job(redisContext *c, const char *job_str, int job_class, int front) {
+    if (backend == QUEUE_STREAM) {
+        return redisAppendCommand(c, "XADD %s * job %s", stream_keys[job_class], job_str);
+    }
+    return redisAppendCommand(c, "%s %s %s", front ? "RPUSH" : "LPUSH",
+        queue_keys[job_class], job_str);
+}
+
+int queue_append_push(struct redis_client *rc, const char *solicitud_id, int cantidad, int digitos,
+                      long long enqueued_ms) {
+    char job_str[256], trace_id[TRACE_ID_LEN + 1];
+    trace_id_from_uuid(solicitud_id, trace_id);
+    if (queue_format_job(job_str, sizeof(job_str), solicitud_id, cantidad, digitos,
+                         enqueued_ms, trace_id) != 0) {
+        return -1;
+    }
+    redisContext *c = redis_client_ctx(rc);
+    if (!c || append_job(c, job_str, queue_job_class(cantidad, digitos), 0) != REDIS_OK) return -1;
+    redis_client_pipelined(rc, 1);
+    return 0;
+}
+
+long long queue_depth(struct redis_client *rc) {
+    if (backend == QUEUE_POSTGRES) return db_count_pending_jobs();
+    if (backend == QUEUE_MEMORY) {
+        pthread_mutex_lock(&mem_lock);
+        long long n = mem_count;
+        pthread_mutex_unlock(&mem_lock);
+        return n;
+    }
+    if (!rc) return -1;
+    for (int i = 0; i < JOB_CLASSES; ++i) {
+        if (backend == QUEUE_STREAM) redis_client_append(rc, "XLEN %s", stream_keys[i]);
+        else redis_client_append(rc, "LLEN %s", queue_keys[i]);
+    }
+    long long total = 0;
+    for (int i = 0; i < JOB_CLASSES; ++i) {
+        redisReply *reply = redis_client_get_reply(rc);
+        if (!reply) return -1;
+        if (reply->type == REDIS_REPLY_INTEGER) total += reply->integer;
+        freeReplyObject(reply);
+    }
+    return total;
+}
+
+// Reencola por el lado que se consume primero (solo se usa con jobs que ya
+// esperaron su turno) y espera la respuesta.
+static void push_front(redisContext *c, const char *job_str, int job_class) {
+    if (append_job(c, job_str, job_class, 1) != REDIS_OK) return;
+    redisReply *reply = NULL;
+    if (redisGetReply(c, (void **)&reply) == REDIS_OK && reply) freeReplyObject(reply);
+}
+
+static void held_add(const char *id, int job_class) {
+    if (n_held >= MAX_HELD) return;
+    snprintf(held[n_held].id, sizeof(held[n_held].id), "%.63s", id);
+    held[n_held].job_class = job_class;
+    n_held++;
+}
+
+static void held_remove(const char *id) {
+    for (int i = 0; i < n_held; ++i) {
+        if (strcmp(held[i].id, id) == 0) {
+            held[i] = held[--n_held];
+            return;
+        }
+    }
+}
+
+// Un paso del round robin ponderado suave: la clase con mas credito.
+static int wrr_next(void) {
+    int total = 0, best = 0;
+    for (int i = 0; i < JOB_CLASSES; ++i) {
+        wrr_current[i] += weights[i];
+        total += weights[i];
+        if (wrr_current[i] > wrr_current[best]) best = i;
+    }
+    wrr_current[best] -= total;
+    return best;
+}
+
+// Orden de clases para este fetch: la preferida por el round robin, el resto
+// por orden de prioridad.
+static void class_order(int order[JOB_CLASSES]) {
+    int best = wrr_next();
+    int n = 0;
+    order[n++] = best;
+    for (int i = 0; i < JOB_CLASSES; ++i) {
+        if (i != best) order[n++] = i;
+    }
+}
+
+// postgres: (re)conecta y se suscribe a los avisos de jobs nuevos.
+static int pg_ensure(void) {
+    if (!pg) return -1;
+    if (PQstatus(pg) == CONNECTION_OK) return 0;
+    log_write(LOG_WARN, "[queue] Postgres connection lost, resetting\n");
+    PQreset(pg);
+    if (PQstatus(pg) != CONNECTION_OK) return -1;
+    PGresult *r = PQexec(pg, "LISTEN " QUEUE_NOTIFY_CHANNEL);
+    int ok = PQresultStatus(r) == PGRES_COMMAND_OK;
+    PQclear(r);
+    return ok ? 0 : -1;
+}
+
+// Espera hasta timeout_ms un NOTIFY del trigger de "cola".
+static void pg_wait_notify(int timeout_ms) {
+    struct pollfd pfd = { PQsocket(pg), POLLIN, 0 };
+    if (pfd.fd < 0 || poll(&pfd, 1, timeout_ms) <= 0) return;
+    PQconsumeInput(pg);
+    PGnotify *n;
+    while ((n = PQnotifies(pg)) != NULL) PQfreemem(n);
+}
+
+static int fetch_pg(struct job *jobs, int max) {
+    if (pg_ensure() != 0) return -1;
+    int n = db_claim_jobs_conn(pg, worker_id, HEARTBEAT_TTL, jobs, max);
+    if (n != 0) return n;
+    pg_wait_notify(1000);
+    return db_claim_jobs_conn(pg, worker_id, HEARTBEAT_TTL, jobs, max);
+}
+
+static int env_int(const char *name, int def) {
+    const char *v = getenv(name);
+    return v && atoi(v) > 0 ? atoi(v) : def;
+}
+
+// memory: crea las solicitudes (en el DB_BACKEND configurado) y las encola.
+static int mem_seed(void) {
+    int n = env_int("BENCH_JOBS", DEFAULT_BENCH_JOBS);
+    int cantidad = env_int("BENCH_CANTIDAD", DEFAULT_BENCH_CANTIDAD);
+    int digitos = env_int("BENCH_DIGITOS", DEFAULT_BENCH_DIGITOS);
+    mem_ring = calloc((size_t)n, sizeof(struct job));
+    if (!mem_ring) return -1;
+    mem_cap = n;
+    long long now = queue_now_ms();
+    for (int i = 0; i < n; ++i) {
+        struct job *job = &mem_ring[i];
+        if (db_create_solicitud(job->solicitud_id, cantidad, digitos) != 0) return -1;
+        snprintf(job->ref, sizeof(job->ref), "%d", i);
+        job->cantidad = cantidad;
+        job->digitos = digitos;
+        job->job_class = queue_job_class(cantidad, digitos);
+        job->enqueued_ms = now;
+        trace_id_from_uuid(job->solicitud_id, job->trace_id);
+    }
+    mem_head = 0;
+    mem_count = n;
+    log_write(LOG_INFO, "[queue] Seeded %d jobs: %d primes of %d digits each\n", n, cantidad, digitos);
+    return 0;
+}
+
+static int fetch_mem(struct job *jobs, int max) {
+    pthread_mutex_lock(&mem_lock);
+    if (mem_count == 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += 1;
+        pthread_cond_timedwait(&mem_not_empty, &mem_lock, &ts);
+    }
+    int n = 0;
+    while (n < max && mem_count > 0) {
+        jobs[n++] = mem_ring[mem_head];
+        mem_head = (mem_head + 1) % mem_cap;
+        mem_count--;
+    }
+    mem_inflight += n;
+    pthread_mutex_unlock(&mem_lock);
+    return n;
+}
+
+static void mem_return(const struct job *job, int cantidad) {
+    pthread_mutex_lock(&mem_lock);
+    if (cantidad > 0 && mem_count < mem_cap) {
+        mem_head = (mem_head + mem_cap - 1) % mem_cap;
+        mem_ring[mem_head] = *job;
+        mem_ring[mem_head].cantidad = cantidad;
+        mem_ring[mem_head].job_class = queue_job_class(cantidad, job->digitos);
+        mem_count++;
+        pthread_cond_signal(&mem_not_empty);
+    }
+    mem_inflight--;
+    pthread_mutex_unlock(&mem_lock);
+}
+
+int queue_drained(void) {
+    if (backend != QUEUE_MEMORY) return 0;
+    pthread_mutex_lock(&mem_lock);
+    int drained = mem_count == 0 && mem_inflight == 0;
+    pthread_mutex_unlock(&mem_lock);
+    return drained;
+}
+
+int queue_worker_init(redisContext *c, const char *id, const char *db_url,
+                      queue_remaining_fn remaining) {
+    snprintf(worker_id, sizeof(worker_id), "%s", id);
+    snprintf(processing_key, sizeof(processing_key), PROCESSING_KEY_FMT, worker_id);
+    snprintf(heartbeat_key, sizeof(heartbeat_key), HEARTBEAT_KEY_FMT, worker_id);
+    remaining_fn = remaining;
+    last_recover = time(NULL);
+
+    if (backend == QUEUE_MEMORY) return mem_seed();
+    if (backend == QUEUE_POSTGRES) {
+        pg = db_open_connection(db_url);
+        if (!pg) return -1;
+        PGresult *r = PQexec(pg, "LISTEN " QUEUE_NOTIFY_CHANNEL);
+        int ok = PQresultStatus(r) == PGRES_COMMAND_OK;
+        if (!ok) log_write(LOG_ERROR, "[queue] LISTEN failed: %s\n", PQerrorMessage(pg));
+        PQclear(r);
+        return ok ? 0 : -1;
+    }
+
+    if (backend == QUEUE_STREAM) {
+        for (int i = 0; i < JOB_CLASSES; ++i) {
+            redisReply *reply = redisCommand(c, "XGROUP CREATE %s %s 0 MKSTREAM",
+                stream_keys[i], QUEUE_GROUP);
+            if (!reply) return -1;
+            int ok = reply->type != REDIS_REPLY_ERROR || strncmp(reply->str, "BUSYGROUP", 9) == 0;
+            if (!ok) log_write(LOG_ERROR, "[queue] XGROUP CREATE %s failed: %s\n", stream_keys[i], reply->str);
+            freeReplyObject(reply);
+            if (!ok) return -1;
+        }
+        return 0;
+    }
+
+    redis_simple(c, "SADD %s %s", WORKERS_KEY, worker_id);
+    queue_heartbeat(c, 1);
+    return 0;
+}
+
+// Convierte una entrada [id, [campo, valor, ...]] de un stream en un job.
+static int stream_entry_to_job(const redisReply *entry, struct job *job) {
+    if (entry->type != REDIS_REPLY_ARRAY || entry->elements < 2 ||
+        entry->element[0]->type != REDIS_REPLY_STRING ||
+        entry->element[1]->type != REDIS_REPLY_ARRAY) {
+        return -1;
+    }
+    const redisReply *fields = entry->element[1];
+    snprintf(job->ref, sizeof(job->ref), "%s", entry->element[0]->str);
+    for (size_t i = 0; i + 1 < fields->elements; i += 2) {
+        if (strcmp(fields->element[i]->str, "job") == 0) {
+            return queue_parse_job(fields->element[i + 1]->str, job);
+        }
+    }
+    return -1;
+}
+
+static void stream_drop(redisContext *c, int job_class, const char *id) {
+    redisAppendCommand(c, "XACK %s %s %s", stream_keys[job_class], QUEUE_GROUP, id);
+    redisAppendCommand(c, "XDEL %s %s", stream_keys[job_class], id);
+    for (int i = 0; i < 2; ++i) {
+        redisReply *reply = NULL;
+        if (redisGetReply(c, (void **)&reply) != REDIS_OK) break;
+        if (reply) freeReplyObject(reply);
+    }
+    held_remove(id);
+}
+
+static int stream_class_of(const char *key) {
+    for (int i = 0; i < JOB_CLASSES; ++i) {
+        if (strcmp(stream_keys[i], key) == 0) return i;
+    }
+    return -1;
+}
+
+// Pasa las entradas de una respuesta de XREADGROUP a "jobs" (lo que exceda
+// "max" queda en local_jobs). Devuelve cuantas tomo, o -1 ante error.
+static int stream_take(redisContext *c, redisReply *reply, struct job *jobs, int *n, int max) {
+    if (!reply) {
+        log_write(LOG_ERROR, "[queue] Redis error on XREADGROUP\n");
+        return -1;
+    }
+    if (reply->type == REDIS_REPLY_NIL) return 0;
+    if (reply->type != REDIS_REPLY_ARRAY) {
+        log_write(LOG_ERROR, "[queue] Unexpected XREADGROUP response\n");
+        return -1;
+    }
+    int taken = 0;
+    for (size_t s = 0; s < reply->elements; ++s) {
+        const redisReply *st = reply->element[s];
+        int k = st->type == REDIS_REPLY_ARRAY && st->elements >= 2 ?
+            stream_class_of(st->element[0]->str) : -1;
+        if (k < 0) continue;
+        const redisReply *entries = st->element[1];
+        for (size_t i = 0; i < entries->elements; ++i) {
+            struct job job;
+            if (stream_entry_to_job(entries->element[i], &job) != 0) {
+                if (entries->element[i]->type == REDIS_REPLY_ARRAY &&
+                    entries->element[i]->elements > 0) {
+                    const char *id = entries->element[i]->element[0]->str;
+                    log_write(LOG_WARN, "[queue] Dropping malformed stream entry %s\n", id);
+                    stream_drop(c, k, id);
+                }
+                continue;
+            }
+            job.job_class = k;
+            held_add(job.ref, job.job_class);
+            if (*n < max) jobs[(*n)++] = job;
+            else if (n_local < MAX_HELD) local_jobs[n_local++] = job;
+            taken++;
+        }
+    }
+    return taken;
+}
+
+// Las plazas del fetch se reparten entre clases con el round robin ponderado
+// (un paso por plaza) y cada stream se lee con su propio COUNT, en un
+// pipeline no bloqueante; lo que una clase no llena lo toman las demas por
+// orden de prioridad. Si no hay nada en ningun stream, un XREADGROUP
+// bloqueante sobre los tres.
+static int fetch_stream(redisContext *c, struct job *jobs, int max) {
+    int n = 0;
+    while (local_head < n_local && n < max) jobs[n++] = local_jobs[local_head++];
+    if (local_head == n_local) local_head = n_local = 0;
+    if (n > 0) return n;
+
+    int count = max < MAX_HELD - n_held ? max : MAX_HELD - n_held;
+    if (count <= 0) return 0;
+    int quota[JOB_CLASSES] = { 0 }, got[JOB_CLASSES] = { 0 };
+    for (int i = 0; i < count; ++i) quota[wrr_next()]++;
+
+    // Todas las respuestas antes de procesarlas: stream_take puede hablar con Redis
+    redisReply *replies[JOB_CLASSES] = { NULL };
+    int sent[JOB_CLASSES] = { 0 }, err = 0;
+    for (int k = 0; k < JOB_CLASSES; ++k) {
+        sent[k] = quota[k] > 0 && redisAppendCommand(c, "XREADGROUP GROUP %s %s COUNT %d STREAMS %s >",
+            QUEUE_GROUP, worker_id, quota[k], stream_keys[k]) == REDIS_OK;
+    }
+    for (int k = 0; k < JOB_CLASSES; ++k) {
+        if (sent[k] && redisGetReply(c, (void **)&replies[k]) != REDIS_OK) replies[k] = NULL;
+    }
+    for (int k = 0; k < JOB_CLASSES; ++k) {
+        if (!sent[k]) continue;
+        got[k] = stream_take(c, replies[k], jobs, &n, max);
+        if (got[k] < 0) err = 1;
+        if (replies[k]) freeReplyObject(replies[k]);
+    }
+    // Una clase que no lleno su cuota esta vacia; las demas pueden tener mas
+    for (int k = 0; k < JOB_CLASSES && n < count && !err; ++k) {
+        if (got[k] < quota[k]) continue;
+        redisReply *reply = redisCommand(c, "XREADGROUP GROUP %s %s COUNT %d STREAMS %s >",
+            QUEUE_GROUP, worker_id, count - n, stream_keys[k]);
+        if (stream_take(c, reply, jobs, &n, max) < 0) err = 1;
+        if (reply) freeReplyObject(reply);
+    }
+    if (n > 0 || err) return n > 0 ? n : -1;
+    if (MAX_HELD - n_held < JOB_CLASSES) return 0;
+
+    redisReply *reply = redisCommand(c,
+        "XREADGROUP GROUP %s %s COUNT 1 BLOCK 5000 STREAMS %s %s %s > > >",
+        QUEUE_GROUP, worker_id, stream_keys[0], stream_keys[1], stream_keys[2]);
+    if (stream_take(c, reply, jobs, &n, max) < 0) err = 1;
+    if (reply) freeReplyObject(reply);
+    return n > 0 || !err ? n : -1;
+}
+
+// Barrido no bloqueante (script Lua, un round trip) en el orden ponderado; si
+// todo esta vacio se bloquea con BLMOVE sobre la clase preferida. BLMPOP no
+// sirve aqui: sacaria el job de Redis sin dejarlo en processing.
+static int fetch_list(redisContext *c, struct job *job) {
+    int order[JOB_CLASSES];
+    class_order(order);
+
+    redisReply *reply = redisCommand(c, "EVAL %s %d %s %s %s %s", SWEEP_SCRIPT, JOB_CLASSES + 1,
+        queue_keys[order[0]], queue_keys[order[1]], queue_keys[order[2]], processing_key);
+    if (reply && reply->type == REDIS_REPLY_NIL) {
+        freeReplyObject(reply);
+        reply = redisCommand(c, "BLMOVE %s %s RIGHT LEFT 1", queue_keys[order[0]], processing_key);
+    }
+    if (!reply) {
+        log_write(LOG_ERROR, "[queue] Redis error on BLMOVE\n");
+        return -1;
+    }
+    if (reply->type == REDIS_REPLY_NIL) {
+        freeReplyObject(reply);
+        return 0;
+    }
+    if (reply->type != REDIS_REPLY_STRING) {
+        log_write(LOG_ERROR, "[queue] Unexpected Redis response: %s\n",
+            reply->type == REDIS_REPLY_ERROR ? reply->str : "?");
+        freeReplyObject(reply);
+        return -1;
+    }
+    if (queue_parse_job(reply->str, job) != 0) {
+        log_write(LOG_WARN, "[queue] Failed to parse job: %s\n", reply->str);
+        redis_simple(c, "LREM %s 1 %s", processing_key, reply->str);
+        freeReplyObject(reply);
+        return -1;
+    }
+    snprintf(job->ref, sizeof(job->ref), "%s", reply->str);
+    freeReplyObject(reply);
+    return 1;
+}
+
+// Devuelve hasta max jobs (list siempre entrega de a uno), 0 si no hubo
+// trabajo antes del timeout y -1 ante error.
+int queue_fetch(redisContext *c, struct job *jobs, int max) {
+    if (max <= 0) return 0;
+    if (backend == QUEUE_POSTGRES) return fetch_pg(jobs, max);
+    if (backend == QUEUE_MEMORY) return fetch_mem(jobs, max);
+    return backend == QUEUE_STREAM ? fetch_stream(c, jobs, max) : fetch_list(c, jobs);
+}
+
+void queue_ack(redisContext *c, const struct job *job) {
+    if (backend == QUEUE_MEMORY) {
+        mem_return(job, 0);
+        return;
+    }
+    if (backend == QUEUE_POSTGRES) {
+        db_mark_job_done_conn(pg, job->ref);
+        return;
+    }
+    if (backend == QUEUE_STREAM) {
+        stream_drop(c, job->job_class, job->ref);
+        return;
+    }
+    redis_simple(c, "LREM %s 1 %s", processing_key, job->ref);
+}
+
+// Devuelve un job a la cola con "remaining" primos pendientes (-1 = tal cual,
+// 0 = descartarlo porque ya esta completo), en la clase que le corresponde
+// ahora y por delante de los jobs que aun no empezaron.
+void queue_requeue(redisContext *c, const struct job *job, int remaining) {
+    if (backend == QUEUE_MEMORY) {
+        mem_return(job, remaining < 0 || remaining > job->cantidad ? job->cantidad : remaining);
+        return;
+    }
+    if (backend == QUEUE_POSTGRES) {
+        int cantidad = remaining < 0 || remaining > job->cantidad ? job->cantidad : remaining;
+        if (remaining == 0) db_mark_job_done_conn(pg, job->ref);
+        else if (db_release_job_conn(pg, job->ref, cantidad) == 0)
+            log_write(LOG_INFO, "[queue] Requeued %s: %d remaining\n", job->solicitud_id, cantidad);
+        return;
+    }
+    if (remaining != 0) {
+        char job_str[256];
+        int cantidad = remaining < 0 || remaining > job->cantidad ? job->cantidad : remaining;
+        queue_format_job(job_str, sizeof(job_str), job->solicitud_id, cantidad, job->digitos,
+            job->enqueued_ms, job->trace_id);
+        push_front(c, job_str, queue_job_class(cantidad, job->digitos));
+        log_write(LOG_INFO, "[queue] Requeued %s: %d remaining\n", job->solicitud_id, cantidad);
+    }
+    if (backend == QUEUE_STREAM) {
+        stream_drop(c, job->job_class, job->ref);
+    } else {
+        redis_simple(c, "LREM %s 1 %s", processing_key, job->ref);
+    }
+}
+
+// Histograma de espera en cola por clase, agregado entre workers en
+// primes:stats:qwait:<clase> (buckets le_<ms> potencias de 2, count, sum_ms).
+void queue_record_wait(redisContext *c, const struct job *job) {
+    if (!c || job->enqueued_ms <= 0) return;
+    long long wait = queue_now_ms() - job->enqueued_ms;
+    if (wait < 0) wait = 0;
+    long long le = 1;
+    while (le < wait && le < (1LL << 24)) le <<= 1;
+
+    char key[64], bucket[32];
+    snprintf(key, sizeof(key), QUEUE_WAIT_KEY_FMT, queue_class_name(job->job_class));
+    if (le < wait) snprintf(bucket, sizeof(bucket), "le_inf");
+    else snprintf(bucket, sizeof(bucket), "le_%lld", le);
+
+    redisAppendCommand(c, "HINCRBY %s %s 1", key, bucket);
+    redisAppendCommand(c, "HINCRBY %s count 1", key);
+    redisAppendCommand(c, "HINCRBY %s sum_ms %lld", key, wait);
+    for (int i = 0; i < 3; ++i) {
+        redisReply *reply = NULL;
+        if (redisGetReply(c, (void **)&reply) != REDIS_OK) break;
+        if (reply) freeReplyObject(reply);
+    }
+}
+
+void queue_heartbeat(redisContext *c, int force) {
+    time_t now = time(NULL);
+    if (!force && now == last_heartbeat) return;
+    last_heartbeat = now;
+
+    if (backend == QUEUE_MEMORY) return;
+    if (backend == QUEUE_POSTGRES) {
+        db_renew_leases_conn(pg, worker_id, HEARTBEAT_TTL);
+        return;
+    }
+    if (backend == QUEUE_LIST) {
+        redis_simple(c, "SET %s %ld EX %d", heartbeat_key, (long)now, HEARTBEAT_TTL);
+        return;
+    }
+    for (int k = 0; k < JOB_CLASSES; ++k) {
+        const char *argv[6 + MAX_HELD];
+        int argc = 0;
+        argv[argc++] = "XCLAIM";
+        argv[argc++] = stream_keys[k];
+        argv[argc++] = QUEUE_GROUP;
+        argv[argc++] = worker_id;
+        argv[argc++] = "0";
+        for (int i = 0; i < n_held; ++i) {
+            if (held[i].job_class == k) argv[argc++] = held[i].id;
+        }
+        if (argc == 5) continue;
+        argv[argc++] = "JUSTID";
+        redisReply *reply = redisCommandArgv(c, argc, argv, NULL);
+        if (reply) freeReplyObject(reply);
+    }
+}
+
+// list: un solo worker (lock) revisa primes:workers y reencola lo que falta
+// de los jobs en processing de los workers cuyo heartbeat expiro.
+static void recover_list(redisContext *c) {
+    redisReply *lock = redisCommand(c, "SET %s %s NX EX %d", REAPER_LOCK_KEY, worker_id, REAPER_INTERVAL);
+    int locked = lock && lock->type == REDIS_REPLY_STATUS;
+    if (lock) freeReplyObject(lock);
+    if (!locked) return;
+
+    redisReply *workers = redisCommand(c, "SMEMBERS %s", WORKERS_KEY);
+    if (!workers || workers->type != REDIS_REPLY_ARRAY) {
+        if (workers) freeReplyObject(workers);
+        return;
+    }
+    for (size_t i = 0; i < workers->elements; ++i) {
+        const char *w = workers->element[i]->str;
+        if (strcmp(w, worker_id) == 0) continue;
+
+        char hb_key[192], proc_key[192];
+        snprintf(hb_key, sizeof(hb_key), HEARTBEAT_KEY_FMT, w);
+        snprintf(proc_key, sizeof(proc_key), PROCESSING_KEY_FMT, w);
+        redisReply *alive = redisCommand(c, "EXISTS %s", hb_key);
+        int is_alive = !alive || alive->type != REDIS_REPLY_INTEGER || alive->integer > 0;
+        if (alive) freeReplyObject(alive);
+        if (is_alive) continue;
+
+        log_write(LOG_INFO, "[queue] Reaping dead worker %s\n", w);
+        redisReply *jobs = redisCommand(c, "LRANGE %s 0 -1", proc_key);
+        if (!jobs || jobs->type != REDIS_REPLY_ARRAY) {
+            if (jobs) freeReplyObject(jobs);
+            continue;
+        }
+        for (size_t j = 0; j < jobs->elements; ++j) {
+            const char *job_str = jobs->element[j]->str;
+            struct job job;
+            if (queue_parse_job(job_str, &job) == 0) {
+                int remaining = remaining_fn ? remaining_fn(&job) : -1;
+                if (remaining != 0) {
+                    char job_out[256];
+                    int cantidad = remaining < 0 || remaining > job.cantidad ? job.cantidad : remaining;
+                    queue_format_job(job_out, sizeof(job_out), job.solicitud_id, cantidad,
+                        job.digitos, job.enqueued_ms, job.trace_id);
+                    push_front(c, job_out, queue_job_class(cantidad, job.digitos));
+                    log_write(LOG_INFO, "[queue] Requeued %s: %d remaining\n", job.solicitud_id, cantidad);
+                }
+            }
+            redis_simple(c, "LREM %s 1 %s", proc_key, job_str);
+        }
+        freeReplyObject(jobs);
+        redis_simple(c, "SREM %s %s", WORKERS_KEY, w);
+    }
+    freeReplyObject(workers);
+}
+
+// stream: XAUTOCLAIM de entradas sin heartbeat (idle > CLAIM_IDLE_MS) y
+// log de longitud, pendientes y lag de cada stream.
+static void recover_stream(redisContext *c) {
+    for (int k = 0; k < JOB_CLASSES; ++k) {
+        int room = MAX_HELD - n_held;
+        if (room > 0) {
+            redisReply *reply = redisCommand(c, "XAUTOCLAIM %s %s %s %d 0-0 COUNT %d",
+                stream_keys[k], QUEUE_GROUP, worker_id, CLAIM_IDLE_MS, room);
+            if (reply && reply->type == REDIS_REPLY_ARRAY && reply->elements >= 2 &&
+                reply->element[1]->type == REDIS_REPLY_ARRAY) {
+                const redisReply *entries = reply->element[1];
+                for (size_t i = 0; i < entries->elements && n_local < MAX_HELD; ++i) {
+                    struct job *job = &local_jobs[n_local];
+                    if (stream_entry_to_job(entries->element[i], job) != 0) continue;
+                    job->job_class = k;
+                    log_write(LOG_INFO, "[queue] Claimed stuck entry %s (%s)\n", job->ref, job->solicitud_id);
+                    held_add(job->ref, k);
+                    n_local++;
+                }
+            }
+            if (reply) freeReplyObject(reply);
+        }
+
+        long long length = -1, pending = -1;
+        redisReply *reply = redisCommand(c, "XLEN %s", stream_keys[k]);
+        if (reply && reply->type == REDIS_REPLY_INTEGER) length = reply->integer;
+        if (reply) freeReplyObject(reply);
+        reply = redisCommand(c, "XPENDING %s %s", stream_keys[k], QUEUE_GROUP);
+        if (reply && reply->type == REDIS_REPLY_ARRAY && reply->elements >= 1 &&
+            reply->element[0]->type == REDIS_REPLY_INTEGER) {
+            pending = reply->element[0]->integer;
+        }
+        if (reply) freeReplyObject(reply);
+        // Las entradas confirmadas se borran (XDEL): lo que queda sin entregar es el lag
+        if (length > 0 && pending >= 0) {
+            log_write(LOG_INFO, "[queue] Stream %s: length=%lld pending=%lld lag=%lld\n",
+                stream_keys[k], length, pending, length - pending);
+        }
+    }
+}
+
+void queue_recover(redisContext *c) {
+    time_t now = time(NULL);
+    if (now - last_recover < REAPER_INTERVAL) return;
+    last_recover = now;
+    // postgres: los leases vencidos se reclaman en el propio fetch
+    if (backend == QUEUE_STREAM) recover_stream(c);
+    else if (backend == QUEUE_LIST) recover_list(c);
+}
+
+// list: si quedara algo en processing se deja registrado para el reaper.
+// stream: lo entregado y no procesado se reencola tal cual.
+// postgres: solo cierra la conexion; lo no devuelto vence con su lease.
+void queue_worker_shutdown(redisContext *c) {
+    if (backend == QUEUE_MEMORY) {
+        free(mem_ring);
+        mem_ring = NULL;
+        mem_cap = mem_count = 0;
+        return;
+    }
+    if (backend == QUEUE_POSTGRES) {
+        db_close_connection(pg);
+        pg = NULL;
+        return;
+    }
+    if (backend == QUEUE_STREAM) {
+        while (n_local > local_head) queue_requeue(c, &local_jobs[--n_local], -1);
+        local_head = n_local = 0;
+        return;
+    }
+    redisReply *len = redisCommand(c, "LLEN %s", processing_key);
+    int empty = len && len->type == REDIS_REPLY_INTEGER && len->integer == 0;
+    if (len) freeReplyObject(len);
+    if (empty) redis_simple(c, "SREM %s %s", WORKERS_KEY, worker_id);
+    redis_simple(c, "DEL %s", heartbeat_key);
+}
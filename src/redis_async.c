@@ -0,0 +1,128 @@
+#define _POSIX_C_SOURCE 200809L
+#include "redis_async.h"
+#include "log.h"
+#include <stdio.h>
+#include <string.h>
+
+#define RECONNECT_MS 1000
+
+static struct mg_mgr *mgr_global = NULL;
+static char host_global[256];
+static int port_global = 0;
+static redisAsyncContext *ac_global = NULL;
+static struct mg_connection *conn_global = NULL;
+static int connected = 0;
+
+// Mongoose solo espera escritura (POLLOUT) en conexiones con datos en su
+// buffer o "conectando"; se marca is_connecting mientras hiredis tenga
+// salida pendiente y en MG_EV_POLL se limpian is_readable/is_writable para
+// que Mongoose no lea ni escriba el socket por su cuenta.
+static void ev_add_write(void *privdata) {
+    struct mg_connection *c = privdata;
+    if (c) c->is_connecting = 1;
+}
+
+static void ev_del_write(void *privdata) {
+    struct mg_connection *c = privdata;
+    if (c) c->is_connecting = 0;
+}
+
+static void ev_noop(void *privdata) {
+    (void)privdata;
+}
+
+// hiredis libera el contexto (y cierra el socket): Mongoose debe olvidar el fd.
+static void ev_cleanup(void *privdata) {
+    struct mg_connection *c = privdata;
+    if (c) {
+        c->fd = (void *)(size_t)MG_INVALID_SOCKET;
+        c->fn_data = NULL;
+        c->is_connecting = 0;
+        c->is_closing = 1;
+    }
+    if (c == conn_global) conn_global = NULL;
+    ac_global = NULL;
+    connected = 0;
+}
+
+static void on_connect(const redisAsyncContext *ac, int status) {
+    if (status != REDIS_OK) {
+        log_write(LOG_WARN, "[api] Async Redis connect failed: %s\n", ac->errstr ? ac->errstr : "?");
+        return;
+    }
+    connected = 1;
+    log_write(LOG_INFO, "[api] Async Redis connected: %s:%d\n", host_global, port_global);
+}
+
+static void on_disconnect(const redisAsyncContext *ac, int status) {
+    if (status != REDIS_OK) {
+        log_write(LOG_WARN, "[api] Async Redis disconnected: %s\n", ac->errstr ? ac->errstr : "?");
+    }
+}
+
+static void conn_handler(struct mg_connection *c, int ev, void *ev_data) {
+    (void)ev_data;
+    redisAsyncContext *ac = c->fn_data;
+    if (ev != MG_EV_POLL || !ac) return;
+
+    if (c->is_closing) {
+        // Error de socket detectado por Mongoose: que hiredis cierre el fd
+        c->fd = (void *)(size_t)MG_INVALID_SOCKET;
+        redisAsyncFree(ac);
+        return;
+    }
+    int readable = c->is_readable, writable = c->is_writable;
+    c->is_readable = c->is_writable = 0;
+    if (readable) redisAsyncHandleRead(ac);
+    if (writable && c->fn_data == ac) redisAsyncHandleWrite(ac);
+}
+
+static void try_connect(void) {
+    redisAsyncContext *ac = redisAsyncConnect(host_global, port_global);
+    if (!ac || ac->err) {
+        log_write(LOG_WARN, "[api] Async Redis connect failed: %s\n",
+            ac && ac->errstr ? ac->errstr : "Out of memory");
+        if (ac) redisAsyncFree(ac);
+        return;
+    }
+    struct mg_connection *c = mg_wrapfd(mgr_global, ac->c.fd, conn_handler, ac);
+    if (!c) {
+        redisAsyncFree(ac);
+        return;
+    }
+    ac->ev.data = c;
+    ac->ev.addRead = ev_noop;
+    ac->ev.delRead = ev_noop;
+    ac->ev.addWrite = ev_add_write;
+    ac->ev.delWrite = ev_del_write;
+    ac->ev.cleanup = ev_cleanup;
+    redisAsyncSetConnectCallback(ac, on_connect);
+    redisAsyncSetDisconnectCallback(ac, on_disconnect);
+    // El primer evento de escritura confirma el connect() no bloqueante
+    c->is_connecting = 1;
+    ac_global = ac;
+    conn_global = c;
+}
+
+static void reconnect_timer(void *arg) {
+    (void)arg;
+    if (!ac_global) try_connect();
+}
+
+int redis_async_init(struct mg_mgr *mgr, const char *host, int port) {
+    mgr_global = mgr;
+    snprintf(host_global, sizeof(host_global), "%s", host);
+    port_global = port;
+    try_connect();
+    mg_timer_add(mgr, RECONNECT_MS, MG_TIMER_REPEAT, reconnect_timer, NULL);
+    return ac_global ? 0 : -1;
+}
+
+void redis_async_free(void) {
+    // Los callbacks pendientes se invocan con reply NULL
+    if (ac_global) redisAsyncFree(ac_global);
+}
+
+redisAsyncContext *redis_async_ctx(void) {
+    return connected && ac_global && !ac_global->err ? ac_global : NULL;
+}
@@ -0,0 +1,165 @@
+#define _POSIX_C_SOURCE 200809L
+#include "redis_client.h"
+#include "metrics.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CONNECT_TIMEOUT_MS 1000
+#define MIN_BACKOFF_MS 100
+#define MAX_BACKOFF_MS 5000
+
+static long long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void record(struct redis_client *rc, long long start_us, int commands) {
+    unsigned long long us = (unsigned long long)(now_us() - start_us);
+    rc->stats.round_trips++;
+    rc->stats.commands += commands;
+    rc->stats.total_us += us;
+    if (us > rc->stats.max_us) rc->stats.max_us = us;
+    metrics_observe_us(rc->latency_metric, us);
+}
+
+static void drop_connection(struct redis_client *rc) {
+    if (!rc->ctx) return;
+    log_write(LOG_WARN, "[redis] Connection to %s:%d lost: %s\n", rc->host, rc->port,
+        rc->ctx->errstr[0] ? rc->ctx->errstr : "unknown error");
+    redisFree(rc->ctx);
+    rc->ctx = NULL;
+    rc->pending = 0;
+    rc->batch = 0;
+}
+
+static int try_connect(struct redis_client *rc) {
+    long long now_ms = now_us() / 1000;
+    if (now_ms < rc->retry_at_ms) return -1;
+
+    struct timeval tv = { CONNECT_TIMEOUT_MS / 1000, (CONNECT_TIMEOUT_MS % 1000) * 1000 };
+    redisContext *c = redisConnectWithTimeout(rc->host, rc->port, tv);
+    if (!c || c->err) {
+        rc->backoff_ms = rc->backoff_ms ? rc->backoff_ms * 2 : MIN_BACKOFF_MS;
+        if (rc->backoff_ms > MAX_BACKOFF_MS) rc->backoff_ms = MAX_BACKOFF_MS;
+        rc->retry_at_ms = now_ms + rc->backoff_ms;
+        log_write(LOG_WARN, "[redis] Connection to %s:%d failed: %s (retry in %d ms)\n",
+            rc->host, rc->port, c ? c->errstr : "Out of memory", rc->backoff_ms);
+        if (c) redisFree(c);
+        return -1;
+    }
+    // Por defecto sin timeout de lectura: BLMOVE y XREADGROUP bloquean a proposito
+    redisSetTimeout(c, (struct timeval){ rc->timeout_ms / 1000, (rc->timeout_ms % 1000) * 1000 });
+    if (rc->connected_once) {
+        rc->stats.reconnects++;
+        log_write(LOG_INFO, "[redis] Reconnected to %s:%d\n", rc->host, rc->port);
+    }
+    rc->connected_once = 1;
+    rc->ctx = c;
+    rc->backoff_ms = 0;
+    rc->retry_at_ms = 0;
+    return 0;
+}
+
+struct redis_client *redis_client_open(const char *host, int port) {
+    struct redis_client *rc = calloc(1, sizeof(*rc));
+    if (!rc) return NULL;
+    snprintf(rc->host, sizeof(rc->host), "%s", host);
+    rc->port = port;
+    rc->latency_metric = -1;
+    try_connect(rc);
+    return rc;
+}
+
+void redis_client_close(struct redis_client *rc) {
+    if (!rc) return;
+    if (rc->ctx) redisFree(rc->ctx);
+    free(rc);
+}
+
+void redis_client_set_timeout(struct redis_client *rc, int timeout_ms) {
+    rc->timeout_ms = timeout_ms > 0 ? timeout_ms : 0;
+    if (rc->ctx) {
+        redisSetTimeout(rc->ctx, (struct timeval){ rc->timeout_ms / 1000, (rc->timeout_ms % 1000) * 1000 });
+    }
+}
+
+redisContext *redis_client_ctx(struct redis_client *rc) {
+    if (rc->ctx && rc->ctx->err) drop_connection(rc);
+    if (!rc->ctx && try_connect(rc) != 0) return NULL;
+    return rc->ctx;
+}
+
+redisReply *redis_client_command(struct redis_client *rc, const char *fmt, ...) {
+    redis_client_discard(rc);
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        redisContext *c = redis_client_ctx(rc);
+        if (!c) return NULL;
+
+        va_list ap;
+        va_start(ap, fmt);
+        long long start = now_us();
+        redisReply *reply = redisvCommand(c, fmt, ap);
+        va_end(ap);
+        if (reply) {
+            record(rc, start, 1);
+            return reply;
+        }
+        rc->stats.errors++;
+        // Un Redis colgado no mejora reintentando: se esperaria el doble
+        int timed_out = c->err == REDIS_ERR_TIMEOUT;
+        drop_connection(rc);
+        if (timed_out) break;
+    }
+    return NULL;
+}
+
+int redis_client_append(struct redis_client *rc, const char *fmt, ...) {
+    redisContext *c = redis_client_ctx(rc);
+    if (!c) return -1;
+    va_list ap;
+    va_start(ap, fmt);
+    int r = redisvAppendCommand(c, fmt, ap);
+    va_end(ap);
+    if (r != REDIS_OK) return -1;
+    redis_client_pipelined(rc, 1);
+    return 0;
+}
+
+void redis_client_pipelined(struct redis_client *rc, int n) {
+    if (rc->pending == 0) {
+        rc->pipeline_start_us = now_us();
+        rc->batch = 0;
+    }
+    rc->pending += n;
+    rc->batch += n;
+}
+
+redisReply *redis_client_get_reply(struct redis_client *rc) {
+    if (!rc->ctx || rc->pending <= 0) return NULL;
+    redisReply *reply = NULL;
+    if (redisGetReply(rc->ctx, (void **)&reply) != REDIS_OK || !reply) {
+        rc->stats.errors++;
+        drop_connection(rc);
+        return NULL;
+    }
+    // Todo el pipeline cuenta como un solo round trip
+    if (--rc->pending == 0) record(rc, rc->pipeline_start_us, rc->batch);
+    return reply;
+}
+
+void redis_client_discard(struct redis_client *rc) {
+    while (rc->pending > 0) {
+        redisReply *reply = redis_client_get_reply(rc);
+        if (!reply) return;
+        freeReplyObject(reply);
+    }
+}
+
+void redis_client_get_stats(const struct redis_client *rc, struct redis_stats *out) {
+    *out = rc->stats;
+}
@@ -4,16 +4,121 @@
 #include <string.h>
 #include <signal.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <math.h>
 #include <hiredis/hiredis.h>
 #include "db.h"
+#include "redis_client.h"
+#include "redis_async.h"
+#include "queue.h"
+#include "cache.h"
+#include "compress.h"
+#include "metrics.h"
+#include "log.h"
+#include "trace.h"
 #include "mongoose.h"
 
 #define DEFAULT_PORT "8000"
+#define EVENTS_CHANNEL "primes:events"
+#define EVENTS_DRAIN_MS 100     // respaldo por si se pierde el aviso de mg_wakeup()
+#define DEFAULT_REDIS_TIMEOUT_MS 200
+#define OUTBOX_BATCH 100
+#define OUTBOX_SWEEP_MS 1000
+#define MAX_WAIT_SECONDS 60
+#define RESULT_PAGE_DEFAULT 1000
+#define RESULT_PAGE_MAX 10000
+#define STREAM_LOW_WATER (64 * 1024)  // se pide otra pagina cuando c->send baja de esto
+#define DEFAULT_RESULT_CACHE_BYTES (64 * 1024 * 1024)
+#define DEFAULT_GZIP_MIN_BYTES 1024
+#define DEFAULT_GZIP_LEVEL 1
+#define QUEUE_DEPTH_MS 5000
+#define DEFAULT_SCALE_TARGET_SECONDS 60
+#define IMMUTABLE_HEADERS "Content-Type: application/json\r\n" \
+    "Cache-Control: public, max-age=31536000, immutable\r\nVary: Accept-Encoding\r\n"
+#define NO_CACHE_JSON_HEADERS "Content-Type: application/json\r\nCache-Control: no-cache\r\n"
 
 static struct mg_mgr mgr;
 static volatile int keep_running = 1;
 static const char *db_url = NULL;
-static redisContext *redis_ctx = NULL;
+static struct redis_client *redis = NULL;
+static const char *redis_host = "localhost";
+static int redis_port = 6379;
+static unsigned long listener_id = 0;
+static int status_verify_every = 0;
+static unsigned long status_cache_hits = 0;
+static pthread_mutex_t outbox_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t outbox_cond = PTHREAD_COND_INITIALIZER;
+static int outbox_pending = 1;
+static size_t gzip_min_bytes = DEFAULT_GZIP_MIN_BYTES;
+static int gzip_level = DEFAULT_GZIP_LEVEL;
+static double scale_target_s = DEFAULT_SCALE_TARGET_SECONDS;
+
+// Metricas de /metrics. Los ids se registran al arrancar; los hilos escriben
+// en su propio shard (ver metrics.h).
+enum route { ROUTE_HEALTH, ROUTE_NEW, ROUTE_STATUS, ROUTE_RESULT, ROUTE_WS, ROUTE_METRICS, ROUTE_SCALE,
+             ROUTE_OTHER, ROUTES };
+static const char *route_names[ROUTES] = { "/", "/new", "/status", "/result", "/ws", "/metrics", "/scale",
+                                           "other" };
+#define CODE_CLASSES 6          // 0: sin respuesta inmediata (long-poll), 1xx..5xx
+static const char *code_names[CODE_CLASSES] = { "none", "1xx", "2xx", "3xx", "4xx", "5xx" };
+enum db_op { DB_CREATE, DB_STATUS, DB_RESULTS, DB_RELAY, DB_PENDING, DB_OPS };
+static const char *db_op_names[DB_OPS] = { "create", "status", "results", "relay", "pending" };
+static int m_requests[ROUTES][CODE_CLASSES];
+static int m_latency[ROUTES];
+static int m_db[DB_OPS];
+static int m_redis = -1;
+static int m_events_coalesced = -1;
+static long long queue_depth_cached = -1;
+static double rates_cached[21];     // primos/s por digitos segun RATES_KEY; 0 = sin medir
+
+// Senal de autoscaling, recalculada junto con la profundidad de la cola
+static double scale_pending_primes = NAN;
+static double scale_pending_s = NAN;      // segundos-worker de trabajo pendiente
+static long long scale_workers = -1;      // workers para drenarlo en scale_target_s
+
+// Suscripciones WebSocket: una entrada por (conexion, solicitud).
+struct ws_sub {
+    struct mg_connection *c;
+    char sid[40];
+};
+static struct ws_sub *ws_subs = NULL;
+static size_t ws_nsubs = 0, ws_cap = 0;
+
+// Eventos de progreso que el hilo de eventos deja para el de Mongoose, uno por
+// solicitud: el progreso se coalesce (solo importa el ultimo) y el de fin,
+// que trae el mayor "generados", nunca se pisa. mg_wakeup() solo avisa que
+// hay algo: es un datagrama no bloqueante que se puede perder sin error, asi
+// que un timer vacia la lista igual cada EVENTS_DRAIN_MS.
+struct pending_event {
+    char sid[40];
+    int generados, cantidad;
+};
+static pthread_mutex_t events_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct pending_event *events_pending = NULL;
+static size_t n_events = 0, events_cap = 0;
+
+// Long-poll: GET /status/{id}?wait=N y /result/{id}?wait=N dejan la conexion
+// estacionada en Mongoose hasta que la solicitud termine (NOTIFY de Postgres o
+// evento de Redis pub/sub) o venza el plazo.
+#define WAIT_MARK 'W'           // en c->data[0]: la conexion tiene un waiter
+#define STREAM_MARK 'S'         // en c->data[0]: /result en curso; el puntero va en c->data + 8
+enum wait_kind { WAIT_STATUS, WAIT_RESULT };
+struct waiter {
+    struct mg_connection *c;
+    char sid[40];
+    int kind;
+    char inm[64];               // If-None-Match de /result, para responder 304
+    int gzip;                   // el cliente acepta Content-Encoding: gzip
+    uint64_t deadline;
+};
+static struct waiter *waiters = NULL;
+static size_t n_waiters = 0, waiters_cap = 0;
+
+// Conexion LISTEN solicitud_done; Mongoose vigila su socket.
+static PGconn *done_pg = NULL;
+static struct mg_connection *done_conn = NULL;
+static volatile int events_subscribed = 0;
 
 static char *extract_field(const char *body, const char *field) {
     char pat[64];
@@ -39,7 +144,61 @@ static char *extract_field(const char *body, const char *field) {
     return out;
 }
 
+// Relay del outbox: un hilo con su propia conexion Postgres y Redis lleva a
+// la cola las solicitudes ya confirmadas. POST /new lo despierta y ademas
+// barre cada OUTBOX_SWEEP_MS lo que dejaron otras replicas o una caida de Redis.
+static void outbox_kick(void) {
+    pthread_mutex_lock(&outbox_lock);
+    outbox_pending = 1;
+    pthread_cond_signal(&outbox_cond);
+    pthread_mutex_unlock(&outbox_lock);
+}
+
+static void *outbox_thread(void *arg) {
+    (void)arg;
+    PGconn *pg = NULL;
+    struct redis_client *rc = redis_client_open(redis_host, redis_port);
+    if (rc) rc->latency_metric = m_redis;
+    while (rc) {
+        pthread_mutex_lock(&outbox_lock);
+        if (!outbox_pending && keep_running) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += OUTBOX_SWEEP_MS / 1000;
+            pthread_cond_timedwait(&outbox_cond, &outbox_lock, &ts);
+        }
+        outbox_pending = 0;
+        pthread_mutex_unlock(&outbox_lock);
+
+        if (!pg) pg = db_open_connection(db_url);
+        if (pg) {
+            int n;
+            do {
+                uint64_t t0 = metrics_now_us();
+                n = db_outbox_relay_conn(pg, rc, OUTBOX_BATCH);
+                metrics_observe_us(m_db[DB_RELAY], metrics_now_us() - t0);
+            } while (n == OUTBOX_BATCH);
+            if (n < 0 && PQstatus(pg) != CONNECTION_OK) {
+                db_close_connection(pg);
+                pg = NULL;
+            }
+        }
+        // Un ultimo barrido tras la senal de apagado
+        if (!keep_running) break;
+    }
+    db_close_connection(pg);
+    redis_client_close(rc);
+    return NULL;
+}
+
+static void reply_new(struct mg_connection *c, const char *id) {
+    char resp[128];
+    snprintf(resp, sizeof(resp), "{\"id\":\"%s\"}\n", id);
+    mg_http_reply(c, 200, "Content-Type: application/json\r\n", resp);
+}
+
 static void handle_new(struct mg_connection *c, struct mg_http_message *hm) {
+    uint64_t span_start = trace_now_ns();
     char body_copy[1024];
     size_t n = hm->body.len < sizeof(body_copy)-1 ? hm->body.len : sizeof(body_copy)-1;
     memcpy(body_copy, hm->body.buf, n);
@@ -66,16 +225,267 @@ static void handle_new(struct mg_connection *c, struct mg_http_message *hm) {
     free(cantidad_s); free(digitos_s);
 
     char id[64];
-    if (db_create_solicitud_and_enqueue(id, cantidad, digitos) != 0) {
+    uint64_t t0 = metrics_now_us(), db_start = trace_now_ns();
+    int r = db_create_solicitud(id, cantidad, digitos);
+    metrics_observe_us(m_db[DB_CREATE], metrics_now_us() - t0);
+    if (r != 0) {
         mg_http_reply(c, 500, "Content-Type: application/json\r\n",
             "{\"error\":\"db insert failed\"}\n");
         return;
     }
-    char resp[128];
-    snprintf(resp, sizeof(resp), "{\"id\":\"%s\"}\n", id);
+    uint64_t db_end = trace_now_ns();
+    if (queue_get_backend() != QUEUE_POSTGRES) outbox_kick();
+    reply_new(c, id);
+    if (trace_enabled()) {
+        // Span raiz de la solicitud; relay y worker cuelgan de el
+        char trace_id[TRACE_ID_LEN + 1], root[SPAN_ID_LEN + 1];
+        struct span_attr attrs[] = { { "cantidad", cantidad }, { "digitos", digitos } };
+        trace_id_from_uuid(id, trace_id);
+        trace_root_span_id(trace_id, root);
+        trace_span(trace_id, NULL, root, "db.create", db_start, db_end, NULL, 0);
+        trace_span(trace_id, root, NULL, "POST /new", span_start, trace_now_ns(), attrs, 2);
+    }
+}
+
+static void status_cache_store(const char *sid, int cantidad, int digitos, int generados) {
+    if (!redis) return;
+    char key[64];
+    snprintf(key, sizeof(key), STATUS_KEY_FMT, sid);
+    redisAsyncContext *ac = redis_async_ctx();
+    if (ac) {
+        redisAsyncCommand(ac, NULL, NULL, "HSET %s cantidad %d digitos %d generados %d",
+            key, cantidad, digitos, generados);
+        redisAsyncCommand(ac, NULL, NULL, "EXPIRE %s %d", key, STATUS_TTL_SECONDS);
+        return;
+    }
+    redis_client_append(redis, "HSET %s cantidad %d digitos %d generados %d",
+        key, cantidad, digitos, generados);
+    redis_client_append(redis, "EXPIRE %s %d", key, STATUS_TTL_SECONDS);
+    redis_client_discard(redis);
+}
+
+// Valores del hash de cache de /status; 1 si esta completo y es coherente.
+static int status_from_reply(const redisReply *reply, int *cantidad, int *digitos, int *generados) {
+    if (!reply || reply->type != REDIS_REPLY_ARRAY || reply->elements != 3 ||
+        reply->element[0]->type != REDIS_REPLY_STRING ||
+        reply->element[1]->type != REDIS_REPLY_STRING ||
+        reply->element[2]->type != REDIS_REPLY_STRING) {
+        return 0;
+    }
+    *cantidad = atoi(reply->element[0]->str);
+    *digitos = atoi(reply->element[1]->str);
+    *generados = atoi(reply->element[2]->str);
+    return *cantidad > 0 && *generados >= 0 && *generados <= *cantidad;
+}
+
+// Completa la consulta segun lo que dio el hash: con acierto, verificacion
+// muestreada contra Postgres; sin el, Postgres y se rellena el cache.
+// Mismos codigos que db_get_status().
+static int status_resolve(const char *sid, int hit, int *cantidad, int *digitos, int *generados) {
+    if (hit) {
+        status_cache_hits++;
+        if (status_verify_every <= 0 || status_cache_hits % status_verify_every != 0) return 0;
+        int c2, d2, g2;
+        uint64_t t0 = metrics_now_us();
+        int r = db_get_status(sid, &c2, &d2, &g2);
+        metrics_observe_us(m_db[DB_STATUS], metrics_now_us() - t0);
+        if (r != 0) return 0;
+        if (c2 == *cantidad && d2 == *digitos && g2 == *generados) return 0;
+        log_write(LOG_WARN, "[api] Status cache mismatch for %s: cache=%d db=%d\n",
+            sid, *generados, g2);
+        *cantidad = c2; *digitos = d2; *generados = g2;
+        status_cache_store(sid, c2, d2, g2);
+        return 0;
+    }
+
+    uint64_t t0 = metrics_now_us();
+    int r = db_get_status(sid, cantidad, digitos, generados);
+    metrics_observe_us(m_db[DB_STATUS], metrics_now_us() - t0);
+    if (r == 0) status_cache_store(sid, *cantidad, *digitos, *generados);
+    return r;
+}
+
+// Progreso de una solicitud: primero el hash de Redis que mantiene el worker,
+// Postgres si falta o es inconsistente. Bloqueante (acotado por el timeout de
+// lectura del cliente); /status usa la variante asincrona.
+static int status_lookup(const char *sid, int *cantidad, int *digitos, int *generados) {
+    char key[64];
+    snprintf(key, sizeof(key), STATUS_KEY_FMT, sid);
+    redisReply *reply = redis ?
+        redis_client_command(redis, "HMGET %s cantidad digitos generados", key) : NULL;
+    int hit = status_from_reply(reply, cantidad, digitos, generados);
+    if (reply) freeReplyObject(reply);
+    return status_resolve(sid, hit, cantidad, digitos, generados);
+}
+
+// Primos/s de un worker para ese largo. Sin medicion propia se escala la del
+// largo medido mas cercano con el costo relativo por digito del clasificador.
+static double rate_for(int digitos) {
+    if (rates_cached[digitos] > 0) return rates_cached[digitos];
+    int best = -1;
+    for (int d = 0; d <= 20; ++d) {
+        if (rates_cached[d] > 0 && (best < 0 || abs(d - digitos) < abs(best - digitos))) best = d;
+    }
+    if (best < 0 || queue_digit_cost(digitos) <= 0) return 0;
+    return rates_cached[best] * queue_digit_cost(best) / queue_digit_cost(digitos);
+}
+
+static void reply_status(struct mg_connection *c, const char *sid, int r,
+                         int cantidad, int digitos, int generados) {
+    if (r == -2) {
+        mg_http_reply(c, 404, "Content-Type: application/json\r\n",
+            "{\"error\":\"not found\"}\n");
+        return;
+    }
+    if (r != 0) {
+        mg_http_reply(c, 500, "Content-Type: application/json\r\n",
+            "{\"error\":\"db error\"}\n");
+        return;
+    }
+    
+    // Estimaciones: eta_ms es lo que falta generar al ritmo medido (o
+    // extrapolado) para ese largo, sin la espera en cola; jobs_en_cola es la
+    // profundidad total de la cola cacheada, no la posicion de esta solicitud.
+    int restantes = cantidad - generados;
+    double rate = digitos >= 0 && digitos <= 20 ? rate_for(digitos) : 0;
+    char eta[32] = "null", depth[32] = "null";
+    if (restantes <= 0) snprintf(eta, sizeof(eta), "0");
+    else if (rate > 0) snprintf(eta, sizeof(eta), "%lld", (long long)(restantes * 1000.0 / rate));
+    if (queue_depth_cached >= 0) snprintf(depth, sizeof(depth), "%lld", queue_depth_cached);
+
+    char resp[320];
+    snprintf(resp, sizeof(resp),
+        "{\"id\":\"%s\",\"cantidad\":%d,\"digitos\":%d,\"generados\":%d,"
+        "\"eta_ms\":%s,\"jobs_en_cola\":%s}\n",
+        sid, cantidad, digitos, generados, eta, depth);
     mg_http_reply(c, 200, "Content-Type: application/json\r\n", resp);
 }
 
+static struct mg_connection *find_conn(unsigned long id) {
+    for (struct mg_connection *c = mgr.conns; c; c = c->next) {
+        if (c->id == id) return c;
+    }
+    return NULL;
+}
+
+// Hay quien avise del fin de una solicitud: LISTEN activo o suscripcion Redis.
+static int can_wait(void) {
+    return done_pg != NULL || events_subscribed;
+}
+
+static int waiter_add(struct mg_connection *c, const char *sid, int kind, const char *inm, int gzip,
+                      int wait_s) {
+    if (n_waiters == waiters_cap) {
+        size_t cap = waiters_cap ? waiters_cap * 2 : 64;
+        struct waiter *w = realloc(waiters, cap * sizeof(*w));
+        if (!w) return -1;
+        waiters = w;
+        waiters_cap = cap;
+    }
+    waiters[n_waiters].c = c;
+    snprintf(waiters[n_waiters].sid, sizeof(waiters[n_waiters].sid), "%s", sid);
+    waiters[n_waiters].kind = kind;
+    snprintf(waiters[n_waiters].inm, sizeof(waiters[n_waiters].inm), "%s", inm ? inm : "");
+    waiters[n_waiters].gzip = gzip;
+    waiters[n_waiters].deadline = mg_millis() + (uint64_t)wait_s * 1000;
+    n_waiters++;
+    c->data[0] = WAIT_MARK;
+    return 0;
+}
+
+static void waiter_remove_at(size_t i) {
+    waiters[i].c->data[0] = 0;
+    waiters[i] = waiters[--n_waiters];
+}
+
+static void waiters_remove_conn(struct mg_connection *c) {
+    for (size_t i = 0; i < n_waiters;) {
+        if (waiters[i].c == c) waiter_remove_at(i);
+        else ++i;
+    }
+}
+
+// Responde, o estaciona la conexion si pidio ?wait y la solicitud no termino.
+static void status_finish(struct mg_connection *c, const char *sid, int wait, int r,
+                          int cantidad, int digitos, int generados) {
+    if (r == 0 && generados < cantidad && wait > 0 && can_wait() &&
+        waiter_add(c, sid, WAIT_STATUS, NULL, 0, wait) == 0) {
+        return;
+    }
+    reply_status(c, sid, r, cantidad, digitos, generados);
+}
+
+// GET /status a la espera del HMGET asincrono.
+struct pending_status {
+    unsigned long conn_id;
+    char sid[40];
+    int wait;
+};
+
+static void on_status_cached(redisAsyncContext *ac, void *r, void *privdata) {
+    (void)ac;
+    struct pending_status *p = privdata;
+    struct mg_connection *c = keep_running ? find_conn(p->conn_id) : NULL;
+    if (c) {
+        int cantidad, digitos, generados;
+        int hit = status_from_reply(r, &cantidad, &digitos, &generados);
+        int res = status_resolve(p->sid, hit, &cantidad, &digitos, &generados);
+        status_finish(c, p->sid, p->wait, res, cantidad, digitos, generados);
+    }
+    free(p);
+}
+
+// El HMGET va por la conexion asincrona y la respuesta sale desde su
+// callback: un Redis lento no frena al resto de las conexiones.
+static void serve_status(struct mg_connection *c, const char *sid, int wait) {
+    redisAsyncContext *ac = redis_async_ctx();
+    struct pending_status *p = ac ? malloc(sizeof(*p)) : NULL;
+    if (p) {
+        char key[64];
+        snprintf(key, sizeof(key), STATUS_KEY_FMT, sid);
+        p->conn_id = c->id;
+        snprintf(p->sid, sizeof(p->sid), "%s", sid);
+        p->wait = wait;
+        if (redisAsyncCommand(ac, on_status_cached, p, "HMGET %s cantidad digitos generados", key) == REDIS_OK)
+            return;
+        free(p);
+    }
+    int cantidad, digitos, generados;
+    int r = status_lookup(sid, &cantidad, &digitos, &generados);
+    status_finish(c, sid, wait, r, cantidad, digitos, generados);
+}
+
+static void serve_result(struct mg_connection *c, const char *sid, const char *inm, int gzip);
+
+static void waiter_serve_at(size_t i) {
+    struct waiter w = waiters[i];
+    waiter_remove_at(i);
+    if (w.kind == WAIT_RESULT) serve_result(w.c, w.sid, w.inm, w.gzip);
+    else serve_status(w.c, w.sid, 0);
+}
+
+// Responde a todos los que esperan la solicitud "sid".
+static void waiters_wake(const char *sid) {
+    for (size_t i = 0; i < n_waiters;) {
+        if (strcmp(waiters[i].sid, sid) != 0) ++i;
+        else waiter_serve_at(i);
+    }
+}
+
+static void waiters_expire(uint64_t now) {
+    for (size_t i = 0; i < n_waiters;) {
+        if (waiters[i].deadline > now) ++i;
+        else waiter_serve_at(i);
+    }
+}
+
+static int wait_param(struct mg_http_message *hm) {
+    char wait_s[16];
+    int wait = 0;
+    if (mg_http_get_var(&hm->query, "wait", wait_s, sizeof(wait_s)) > 0) wait = atoi(wait_s);
+    return wait > MAX_WAIT_SECONDS ? MAX_WAIT_SECONDS : wait;
+}
+
 static void handle_status(struct mg_connection *c, struct mg_http_message *hm) {
     char path[128];
     snprintf(path, sizeof(path), "%.*s", (int)hm->uri.len, hm->uri.buf);
@@ -87,30 +497,286 @@ static void handle_status(struct mg_connection *c, struct mg_http_message *hm) {
     }
     
     const char *sid = path + strlen(prefix);
-    if (!sid || !*sid) {
+    if (!sid || !*sid || strlen(sid) >= sizeof(((struct waiter *)0)->sid)) {
         mg_http_reply(c, 400, "Content-Type: application/json\r\n",
             "{\"error\":\"missing id\"}\n");
         return;
     }
     
-    int cantidad, digitos, generados;
-    int r = db_get_status(sid, &cantidad, &digitos, &generados);
-    if (r == -2) {
-        mg_http_reply(c, 404, "Content-Type: application/json\r\n",
-            "{\"error\":\"not found\"}\n");
+    serve_status(c, sid, wait_param(hm));
+}
+
+// "inm" es el valor de If-None-Match ("" si no vino).
+static int etag_matches(const char *inm, const char *etag) {
+    if (strcmp(inm, "*") == 0) return 1;
+    return strstr(inm, etag) != NULL;
+}
+
+// Accept-Encoding incluye gzip sin q=0.
+static int accepts_gzip(struct mg_http_message *hm) {
+    struct mg_str *ae = mg_http_get_header(hm, "Accept-Encoding");
+    if (!ae) return 0;
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%.*s", (int)ae->len, ae->buf);
+    const char *p = strstr(buf, "gzip");
+    if (!p) return 0;
+    p += 4;
+    while (*p == ' ') ++p;
+    if (strncmp(p, ";q=", 3) == 0 && atof(p + 3) <= 0.0) return 0;
+    return 1;
+}
+
+// Responde un cuerpo sin cache, comprimido si el cliente acepta gzip y
+// supera GZIP_MIN_BYTES. "headers" lleva Content-Type y Cache-Control.
+static void reply_body(struct mg_connection *c, const char *headers, const char *body,
+                       size_t len, int gzip) {
+    char *gz = NULL;
+    size_t gz_len = 0;
+    if (gzip && len >= gzip_min_bytes && gzip_compress(body, len, gzip_level, &gz, &gz_len) == 0) {
+        mg_printf(c, "HTTP/1.1 200 OK\r\n%sContent-Encoding: gzip\r\nVary: Accept-Encoding\r\n"
+            "Content-Length: %lu\r\n\r\n", headers, (unsigned long)gz_len);
+        mg_send(c, gz, gz_len);
+        free(gz);
         return;
     }
-    if (r != 0) {
+    mg_printf(c, "HTTP/1.1 200 OK\r\n%sVary: Accept-Encoding\r\nContent-Length: %lu\r\n\r\n",
+        headers, (unsigned long)len);
+    mg_send(c, body, len);
+}
+
+static void reply_cached(struct mg_connection *c, const char *inm,
+                         const struct cache_entry *e, int gzip) {
+    // La version gzip se comprime una sola vez y queda junto al cuerpo
+    if (gzip && !e->gz && e->len >= gzip_min_bytes) {
+        char *gz;
+        size_t gz_len;
+        if (gzip_compress(e->body, e->len, gzip_level, &gz, &gz_len) == 0) cache_set_gzip(e, gz, gz_len);
+    }
+    if (gzip && e->gz) {
+        // Cada codificacion tiene su propio ETag fuerte
+        char etag[32];
+        snprintf(etag, sizeof(etag), "%.*s-gz\"", (int)strlen(e->etag) - 1, e->etag);
+        if (etag_matches(inm, etag)) {
+            char headers[192];
+            snprintf(headers, sizeof(headers), IMMUTABLE_HEADERS "ETag: %s\r\n", etag);
+            mg_http_reply(c, 304, headers, "");
+            return;
+        }
+        mg_printf(c, "HTTP/1.1 200 OK\r\n" IMMUTABLE_HEADERS "Content-Encoding: gzip\r\nETag: %s\r\n"
+            "Content-Length: %lu\r\n\r\n", etag, (unsigned long)e->gz_len);
+        mg_send(c, e->gz, e->gz_len);
+        return;
+    }
+    if (etag_matches(inm, e->etag)) {
+        char headers[192];
+        snprintf(headers, sizeof(headers), IMMUTABLE_HEADERS "ETag: %s\r\n", e->etag);
+        mg_http_reply(c, 304, headers, "");
+        return;
+    }
+    mg_printf(c, "HTTP/1.1 200 OK\r\n" IMMUTABLE_HEADERS "ETag: %s\r\nContent-Length: %lu\r\n\r\n",
+        e->etag, (unsigned long)e->len);
+    mg_send(c, e->body, e->len);
+}
+
+// Formatos de /result negociados por Accept. JSON es el de siempre; NDJSON
+// (un primo por linea) y binario (uint64 little-endian) se envian en chunks,
+// pagina a pagina, para no armar el resultado entero en memoria.
+enum result_format { FMT_JSON, FMT_NDJSON, FMT_BINARY };
+
+struct result_stream {
+    char sid[40];
+    char after[128];
+    int format;
+    int gzip;
+    struct gzip_stream gs;      // deflate incremental si gzip
+};
+
+static int result_format(struct mg_http_message *hm) {
+    struct mg_str *accept = mg_http_get_header(hm, "Accept");
+    if (!accept) return FMT_JSON;
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%.*s", (int)accept->len, accept->buf);
+    if (strstr(buf, "application/x-ndjson")) return FMT_NDJSON;
+    if (strstr(buf, "application/octet-stream")) return FMT_BINARY;
+    return FMT_JSON;
+}
+
+static const char *format_headers(int format) {
+    return format == FMT_BINARY
+        ? "Content-Type: application/octet-stream\r\nCache-Control: no-cache\r\n"
+        : "Content-Type: application/x-ndjson\r\nCache-Control: no-cache\r\n";
+}
+
+// Codifica "arr" en el formato pedido; devuelve los bytes escritos en "out"
+// (que debe tener 8 bytes o strlen+1 por primo).
+static size_t encode_primes(int format, char **arr, int count, char *out) {
+    size_t len = 0;
+    for (int i = 0; i < count; ++i) {
+        if (format == FMT_BINARY) {
+            unsigned long long v = strtoull(arr[i], NULL, 10);
+            for (int b = 0; b < 8; ++b) out[len++] = (char)(v >> (8 * b));
+        } else {
+            size_t n = strlen(arr[i]);
+            memcpy(out + len, arr[i], n);
+            out[len + n] = '\n';
+            len += n + 1;
+        }
+    }
+    return len;
+}
+
+static size_t encoded_size(int format, char **arr, int count) {
+    size_t n = 0;
+    for (int i = 0; i < count; ++i) n += format == FMT_BINARY ? 8 : strlen(arr[i]) + 1;
+    return n;
+}
+
+static void result_stream_free(struct result_stream *st) {
+    if (st->gzip) gzip_stream_free(&st->gs);
+    free(st);
+}
+
+// Escribe un chunk, pasandolo antes por deflate si corresponde. "finish"
+// vacia el compresor (trailer gzip). 0 ok, -1 error.
+static int result_stream_emit(struct mg_connection *c, struct result_stream *st,
+                              const char *buf, size_t len, int finish) {
+    if (!st->gzip) {
+        if (len) mg_http_write_chunk(c, buf, len);
+        return 0;
+    }
+    const char *out;
+    size_t out_len;
+    if (gzip_stream_write(&st->gs, buf, len, &out, &out_len) != 0) return -1;
+    if (out_len) mg_http_write_chunk(c, out, out_len);
+    if (!finish) return 0;
+    if (gzip_stream_finish(&st->gs, &out, &out_len) != 0) return -1;
+    if (out_len) mg_http_write_chunk(c, out, out_len);
+    return 0;
+}
+
+// Paginas siguientes de un stream mientras el buffer de envio tenga lugar; al
+// terminar cierra el chunked y libera el estado.
+static void result_stream_step(struct mg_connection *c) {
+    struct result_stream *st;
+    memcpy(&st, c->data + 8, sizeof(st));
+    int done = 0;
+    while (!done && c->send.len < STREAM_LOW_WATER) {
+        int count;
+        uint64_t t0 = metrics_now_us();
+        char **arr = db_get_results_page(st->sid, st->after, RESULT_PAGE_MAX, &count);
+        metrics_observe_us(m_db[DB_RESULTS], metrics_now_us() - t0);
+        char *out = count > 0 ? malloc(encoded_size(st->format, arr, count)) : NULL;
+        if (count == -1 || (count > 0 && !out)) {
+            // Las cabeceras ya salieron: solo queda cortar la respuesta
+            if (count > 0) db_free_results(arr, count);
+            c->is_draining = 1;
+            done = 1;
+            break;
+        }
+        size_t len = count > 0 ? encode_primes(st->format, arr, count, out) : 0;
+        if (count > 0) snprintf(st->after, sizeof(st->after), "%s", arr[count - 1]);
+        done = count < RESULT_PAGE_MAX;
+        if (result_stream_emit(c, st, out, len, done) != 0) {
+            c->is_draining = 1;
+            done = 1;
+        } else if (done) {
+            mg_http_write_chunk(c, "", 0);
+        }
+        free(out);
+        db_free_results(arr, count);
+    }
+    if (done) {
+        result_stream_free(st);
+        c->data[0] = 0;
+    }
+}
+
+static void serve_result_stream(struct mg_connection *c, const char *sid, int format, int gzip) {
+    struct result_stream *st = calloc(1, sizeof(*st));
+    if (st && gzip) {
+        if (gzip_stream_init(&st->gs, gzip_level) == 0) st->gzip = 1;
+    }
+    if (!st) {
+        mg_http_reply(c, 500, "Content-Type: application/json\r\n",
+            "{\"error\":\"out of memory\"}\n");
+        return;
+    }
+    snprintf(st->sid, sizeof(st->sid), "%s", sid);
+    st->format = format;
+    mg_printf(c, "HTTP/1.1 200 OK\r\n%s%sVary: Accept-Encoding\r\nTransfer-Encoding: chunked\r\n\r\n",
+        format_headers(format), st->gzip ? "Content-Encoding: gzip\r\n" : "");
+    c->data[0] = STREAM_MARK;
+    memcpy(c->data + 8, &st, sizeof(st));
+    result_stream_step(c);
+}
+
+static void serve_result_page(struct mg_connection *c, struct mg_http_message *hm, const char *sid) {
+    char after[128] = "", limit_s[16] = "";
+    mg_http_get_var(&hm->query, "after", after, sizeof(after));
+    mg_http_get_var(&hm->query, "limit", limit_s, sizeof(limit_s));
+    int limit = limit_s[0] ? atoi(limit_s) : RESULT_PAGE_DEFAULT;
+    int valid = limit > 0;
+    for (const char *p = after; *p; ++p) {
+        if (*p < '0' || *p > '9') valid = 0;
+    }
+    // El cursor se compara por longitud: sin ceros a la izquierda
+    const char *cursor = after;
+    while (*cursor == '0') ++cursor;
+    if (!valid) {
+        mg_http_reply(c, 400, "Content-Type: application/json\r\n",
+            "{\"error\":\"invalid after/limit\"}\n");
+        return;
+    }
+    if (limit > RESULT_PAGE_MAX) limit = RESULT_PAGE_MAX;
+
+    int count;
+    uint64_t t0 = metrics_now_us();
+    char **arr = db_get_results_page(sid, cursor, limit, &count);
+    metrics_observe_us(m_db[DB_RESULTS], metrics_now_us() - t0);
+    if (count == -1) {
         mg_http_reply(c, 500, "Content-Type: application/json\r\n",
             "{\"error\":\"db error\"}\n");
         return;
     }
-    
-    char resp[256];
-    snprintf(resp, sizeof(resp),
-        "{\"id\":\"%s\",\"cantidad\":%d,\"digitos\":%d,\"generados\":%d}\n",
-        sid, cantidad, digitos, generados);
-    mg_http_reply(c, 200, "Content-Type: application/json\r\n", resp);
+
+    int format = result_format(hm);
+    int gzip = accepts_gzip(hm);
+    if (format != FMT_JSON) {
+        // El cursor de la pagina siguiente es el ultimo primo recibido
+        char *bin = malloc(encoded_size(format, arr, count) + 1);
+        if (bin) {
+            reply_body(c, format_headers(format), bin, encode_primes(format, arr, count, bin), gzip);
+        } else {
+            mg_http_reply(c, 500, "Content-Type: application/json\r\n",
+                "{\"error\":\"out of memory\"}\n");
+        }
+        free(bin);
+        db_free_results(arr, count);
+        return;
+    }
+
+    size_t bufsz = strlen(sid) + 64;
+    for (int i = 0; i < count; ++i) bufsz += 2 * strlen(arr[i]) + 4;
+    char *out = malloc(bufsz);
+    if (!out) {
+        db_free_results(arr, count);
+        mg_http_reply(c, 500, "Content-Type: application/json\r\n",
+            "{\"error\":\"out of memory\"}\n");
+        return;
+    }
+    size_t len = (size_t)snprintf(out, bufsz, "{\"id\":\"%s\",\"primos\":[", sid);
+    for (int i = 0; i < count; ++i) {
+        len += (size_t)snprintf(out + len, bufsz - len, "%s\"%s\"", i ? "," : "", arr[i]);
+    }
+    // "siguiente" es el cursor para ?after=; null en la ultima pagina
+    if (count == limit) {
+        snprintf(out + len, bufsz - len, "],\"siguiente\":\"%s\"}\n", arr[count - 1]);
+    } else {
+        snprintf(out + len, bufsz - len, "],\"siguiente\":null}\n");
+    }
+    reply_body(c, NO_CACHE_JSON_HEADERS, out, strlen(out), gzip);
+    free(out);
+    db_free_results(arr, count);
 }
 
 static void handle_result(struct mg_connection *c, struct mg_http_message *hm) {
@@ -125,14 +791,56 @@ static void handle_result(struct mg_connection *c, struct mg_http_message *hm) {
     }
     
     const char *sid = path + strlen(prefix);
-    if (!sid || !*sid) {
+    if (!sid || !*sid || strlen(sid) >= sizeof(((struct waiter *)0)->sid)) {
         mg_http_reply(c, 400, "Content-Type: application/json\r\n",
             "{\"error\":\"missing id\"}\n");
         return;
     }
+
+    // ?after=<primo>&limit=N: pagina por clave, sin cache ni espera
+    struct mg_str after_v = mg_http_var(hm->query, mg_str("after"));
+    struct mg_str limit_v = mg_http_var(hm->query, mg_str("limit"));
+    if (after_v.buf || limit_v.buf) {
+        serve_result_page(c, hm, sid);
+        return;
+    }
+    int format = result_format(hm);
+    int gzip = accepts_gzip(hm);
+    if (format != FMT_JSON) {
+        serve_result_stream(c, sid, format, gzip);
+        return;
+    }
+
+    char inm[64] = "";
+    struct mg_str *inm_hdr = mg_http_get_header(hm, "If-None-Match");
+    if (inm_hdr) snprintf(inm, sizeof(inm), "%.*s", (int)inm_hdr->len, inm_hdr->buf);
+
+    int wait = wait_param(hm);
+    if (wait > 0 && can_wait() && !cache_get(sid)) {
+        int cantidad, digitos, generados;
+        if (status_lookup(sid, &cantidad, &digitos, &generados) == 0 && generados < cantidad &&
+            waiter_add(c, sid, WAIT_RESULT, inm, gzip, wait) == 0) {
+            return;
+        }
+    }
+    serve_result(c, sid, inm, gzip);
+}
+
+static void serve_result(struct mg_connection *c, const char *sid, const char *inm, int gzip) {
+    const struct cache_entry *cached = cache_get(sid);
+    if (cached) {
+        reply_cached(c, inm, cached, gzip);
+        return;
+    }
+
+    int cantidad = 0, digitos, generados = -1;
+    int complete = status_lookup(sid, &cantidad, &digitos, &generados) == 0 &&
+        generados >= cantidad;
     
     int count;
+    uint64_t t0 = metrics_now_us();
     char **arr = db_get_results(sid, &count);
+    metrics_observe_us(m_db[DB_RESULTS], metrics_now_us() - t0);
     if (count == -1) {
         mg_http_reply(c, 500, "Content-Type: application/json\r\n",
             "{\"error\":\"db error\"}\n");
@@ -151,17 +859,393 @@ static void handle_result(struct mg_connection *c, struct mg_http_message *hm) {
         if (i < count-1) strcat(out, ",");
     }
     strcat(out, "]}\n");
-    mg_http_reply(c, 200, "Content-Type: application/json\r\n", out);
+
+    // Completa: el cuerpo ya no cambia, se guarda y se sirve como inmutable
+    if (complete && count == cantidad && (cached = cache_put(sid, out, strlen(out))) != NULL) {
+        reply_cached(c, inm, cached, gzip);
+    } else {
+        reply_body(c, NO_CACHE_JSON_HEADERS, out, strlen(out), gzip);
+    }
     free(out);
     db_free_results(arr, count);
 }
 
+static void ws_send_progress(struct mg_connection *c, const char *sid, int generados, int cantidad) {
+    if (generados >= cantidad) {
+        mg_ws_printf(c, WEBSOCKET_OP_TEXT, "{\"id\":\"%s\",\"g\":%d,\"c\":%d,\"done\":true}",
+            sid, generados, cantidad);
+    } else {
+        mg_ws_printf(c, WEBSOCKET_OP_TEXT, "{\"id\":\"%s\",\"g\":%d,\"c\":%d}",
+            sid, generados, cantidad);
+    }
+}
+
+static int ws_find(struct mg_connection *c, const char *sid) {
+    for (size_t i = 0; i < ws_nsubs; ++i) {
+        if (ws_subs[i].c == c && strcmp(ws_subs[i].sid, sid) == 0) return (int) i;
+    }
+    return -1;
+}
+
+static void ws_remove_at(size_t i) {
+    ws_subs[i] = ws_subs[--ws_nsubs];
+}
+
+static void ws_unsubscribe_conn(struct mg_connection *c) {
+    for (size_t i = 0; i < ws_nsubs;) {
+        if (ws_subs[i].c == c) ws_remove_at(i);
+        else ++i;
+    }
+}
+
+static void ws_subscribe(struct mg_connection *c, const char *sid) {
+    int cantidad, digitos, generados;
+    int r = status_lookup(sid, &cantidad, &digitos, &generados);
+    if (r == -2) {
+        mg_ws_printf(c, WEBSOCKET_OP_TEXT, "{\"id\":\"%s\",\"error\":\"not found\"}", sid);
+        return;
+    }
+    if (r != 0) {
+        mg_ws_printf(c, WEBSOCKET_OP_TEXT, "{\"id\":\"%s\",\"error\":\"db error\"}", sid);
+        return;
+    }
+    // Estado inicial para que el cliente no dependa de eventos perdidos
+    ws_send_progress(c, sid, generados, cantidad);
+    if (generados >= cantidad || ws_find(c, sid) >= 0) return;
+
+    if (ws_nsubs == ws_cap) {
+        size_t cap = ws_cap ? ws_cap * 2 : 64;
+        struct ws_sub *p = realloc(ws_subs, cap * sizeof(*p));
+        if (!p) return;
+        ws_subs = p;
+        ws_cap = cap;
+    }
+    ws_subs[ws_nsubs].c = c;
+    snprintf(ws_subs[ws_nsubs].sid, sizeof(ws_subs[ws_nsubs].sid), "%s", sid);
+    ws_nsubs++;
+}
+
+// Mensajes del cliente: {"subscribe":["id",...]} y/o {"unsubscribe":["id",...]}
+static void handle_ws_message(struct mg_connection *c, struct mg_ws_message *wm) {
+    const char *ops[] = { "$.subscribe", "$.unsubscribe" };
+    for (int op = 0; op < 2; ++op) {
+        struct mg_str arr = mg_json_get_tok(wm->data, ops[op]);
+        if (arr.len == 0 || arr.buf[0] != '[') continue;
+        struct mg_str val;
+        size_t ofs = 0;
+        while ((ofs = mg_json_next(arr, ofs, NULL, &val)) > 0) {
+            if (val.len < 3 || val.len > 38 || val.buf[0] != '"') continue;
+            char sid[40];
+            snprintf(sid, sizeof(sid), "%.*s", (int) val.len - 2, val.buf + 1);
+            if (op == 0) {
+                ws_subscribe(c, sid);
+            } else {
+                int i = ws_find(c, sid);
+                if (i >= 0) ws_remove_at((size_t) i);
+            }
+        }
+    }
+}
+
+static void ws_dispatch(const char *sid, int generados, int cantidad) {
+    for (size_t i = 0; i < ws_nsubs;) {
+        if (strcmp(ws_subs[i].sid, sid) != 0) { ++i; continue; }
+        ws_send_progress(ws_subs[i].c, sid, generados, cantidad);
+        if (generados >= cantidad) ws_remove_at(i);
+        else ++i;
+    }
+    if (generados >= cantidad) waiters_wake(sid);
+}
+
+// Hilo de eventos: guarda el ultimo estado de la solicitud. 1 si la lista
+// estaba vacia (hay que avisar al hilo de Mongoose).
+static int events_push(const char *sid, int generados, int cantidad) {
+    pthread_mutex_lock(&events_lock);
+    int was_empty = n_events == 0;
+    size_t i = 0;
+    while (i < n_events && strcmp(events_pending[i].sid, sid) != 0) ++i;
+    if (i < n_events) {
+        if (generados > events_pending[i].generados) events_pending[i].generados = generados;
+        metrics_inc(m_events_coalesced);
+    } else {
+        if (n_events == events_cap) {
+            size_t cap = events_cap ? events_cap * 2 : 64;
+            struct pending_event *p = realloc(events_pending, cap * sizeof(*p));
+            if (!p) {
+                pthread_mutex_unlock(&events_lock);
+                return 0;
+            }
+            events_pending = p;
+            events_cap = cap;
+        }
+        snprintf(events_pending[n_events].sid, sizeof(events_pending[n_events].sid), "%s", sid);
+        events_pending[n_events].generados = generados;
+        events_pending[n_events].cantidad = cantidad;
+        n_events++;
+    }
+    pthread_mutex_unlock(&events_lock);
+    return was_empty;
+}
+
+// Hilo de Mongoose: entrega todo lo pendiente a los suscriptores.
+static void events_drain(void) {
+    pthread_mutex_lock(&events_lock);
+    struct pending_event *ev = events_pending;
+    size_t n = n_events;
+    events_pending = NULL;
+    n_events = events_cap = 0;
+    pthread_mutex_unlock(&events_lock);
+    for (size_t i = 0; i < n; ++i) ws_dispatch(ev[i].sid, ev[i].generados, ev[i].cantidad);
+    free(ev);
+}
+
+static void events_timer(void *arg) {
+    (void)arg;
+    events_drain();
+}
+
+static void done_listener_drop(void) {
+    if (done_conn) {
+        done_conn->fd = (void *)(size_t)MG_INVALID_SOCKET;    // lo cierra PQfinish
+        done_conn->is_closing = 1;
+        done_conn = NULL;
+    }
+    db_close_connection(done_pg);
+    done_pg = NULL;
+}
+
+static void done_listener_fn(struct mg_connection *c, int ev, void *ev_data) {
+    (void)ev_data;
+    if (ev != MG_EV_POLL || c != done_conn) return;
+    if (c->is_closing) {
+        done_listener_drop();
+        return;
+    }
+    int readable = c->is_readable;
+    c->is_readable = c->is_writable = 0;    // el socket es de libpq
+    if (!readable) return;
+    if (!PQconsumeInput(done_pg)) {
+        log_write(LOG_ERROR, "[api] LISTEN connection lost: %s", PQerrorMessage(done_pg));
+        done_listener_drop();
+        return;
+    }
+    PGnotify *n;
+    while ((n = PQnotifies(done_pg)) != NULL) {
+        waiters_wake(n->extra);
+        PQfreemem(n);
+    }
+}
+
+static void done_listener_start(void) {
+    done_pg = db_open_connection(db_url);
+    if (!done_pg) return;
+    PGresult *r = PQexec(done_pg, "LISTEN " DONE_CHANNEL);
+    int ok = PQresultStatus(r) == PGRES_COMMAND_OK;
+    PQclear(r);
+    if (ok) done_conn = mg_wrapfd(&mgr, PQsocket(done_pg), done_listener_fn, NULL);
+    if (!done_conn) {
+        log_write(LOG_ERROR, "[api] LISTEN %s failed\n", DONE_CHANNEL);
+        db_close_connection(done_pg);
+        done_pg = NULL;
+    }
+}
+
+// Cada segundo: vencer long-polls y reabrir el LISTEN si se cayo.
+static void wait_timer(void *arg) {
+    (void)arg;
+    waiters_expire(mg_millis());
+    if (!done_pg) done_listener_start();
+}
+
+static void handle_health(struct mg_connection *c) {
+    struct redis_stats st = { 0 };
+    if (redis) redis_client_get_stats(redis, &st);
+    mg_http_reply(c, 200, "Content-Type: application/json\r\n",
+        "{\"status\":\"ok\",\"redis\":{\"up\":%s,\"round_trips\":%llu,\"commands\":%llu,"
+        "\"errors\":%llu,\"reconnects\":%llu,\"avg_us\":%llu,\"max_us\":%llu}}",
+        redis && redis->ctx && !redis->ctx->err ? "true" : "false",
+        st.round_trips, st.commands, st.errors, st.reconnects,
+        st.round_trips ? st.total_us / st.round_trips : 0ULL, st.max_us);
+}
+
+// GET /scale: workers necesarios para terminar lo pendiente en SCALE_TARGET_SECONDS al
+// ritmo medido; pensado para el scaler metrics-api de KEDA (valueLocation "workers").
+static void handle_scale(struct mg_connection *c) {
+    char primes[32] = "null", pending[32] = "null", workers[32] = "null";
+    if (!isnan(scale_pending_primes)) snprintf(primes, sizeof(primes), "%.0f", scale_pending_primes);
+    if (!isnan(scale_pending_s)) snprintf(pending, sizeof(pending), "%.1f", scale_pending_s);
+    if (scale_workers >= 0) snprintf(workers, sizeof(workers), "%lld", scale_workers);
+    mg_http_reply(c, scale_workers >= 0 ? 200 : 503, NO_CACHE_JSON_HEADERS,
+        "{\"primos_pendientes\":%s,\"trabajo_pendiente_s\":%s,\"objetivo_s\":%.0f,\"workers\":%s}\n",
+        primes, pending, scale_target_s, workers);
+}
+
+static void handle_metrics(struct mg_connection *c) {
+    char *text = NULL;
+    size_t len = metrics_render(&text);
+    mg_printf(c, "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: %lu\r\n\r\n", (unsigned long)len);
+    mg_send(c, text, len);
+    free(text);
+}
+
+static double gauge_connections(void *arg) {
+    (void)arg;
+    double n = 0;
+    for (struct mg_connection *c = mgr.conns; c; c = c->next) {
+        if (c->is_accepted) n++;
+    }
+    return n;
+}
+
+static double gauge_waiters(void *arg) {
+    (void)arg;
+    return (double)n_waiters;
+}
+
+static double gauge_queue_depth(void *arg) {
+    (void)arg;
+    return queue_depth_cached < 0 ? NAN : (double)queue_depth_cached;
+}
+
+static double gauge_pending_work(void *arg) {
+    (void)arg;
+    return scale_pending_s;
+}
+
+static double gauge_desired_workers(void *arg) {
+    (void)arg;
+    return scale_workers < 0 ? NAN : (double)scale_workers;
+}
+
+static double gauge_cache_bytes(void *arg) {
+    (void)arg;
+    return (double)cache_bytes();
+}
+
+static void metrics_setup(void) {
+    char labels[96];
+    // Una familia a la vez: el exposition format pide sus series contiguas
+    for (int r = 0; r < ROUTES; ++r) {
+        for (int k = 0; k < CODE_CLASSES; ++k) {
+            snprintf(labels, sizeof(labels), "route=\"%s\",code=\"%s\"", route_names[r], code_names[k]);
+            m_requests[r][k] = metrics_counter("api_http_requests_total",
+                "Peticiones HTTP por ruta y clase de codigo", labels);
+        }
+    }
+    m_events_coalesced = metrics_counter("api_events_coalesced_total",
+        "Eventos de progreso pisados por uno mas nuevo de la misma solicitud antes de llegar a /ws", NULL);
+    for (int r = 0; r < ROUTES; ++r) {
+        snprintf(labels, sizeof(labels), "route=\"%s\"", route_names[r]);
+        m_latency[r] = metrics_histogram("api_http_request_duration_seconds",
+            "Tiempo en el handler hasta escribir la respuesta", labels);
+    }
+    for (int op = 0; op < DB_OPS; ++op) {
+        snprintf(labels, sizeof(labels), "op=\"%s\"", db_op_names[op]);
+        m_db[op] = metrics_histogram("api_db_call_duration_seconds", "Latencia de llamadas a Postgres", labels);
+    }
+    m_redis = metrics_histogram("api_redis_call_duration_seconds",
+        "Latencia por round trip a Redis (un pipeline cuenta una vez)", NULL);
+    metrics_gauge("api_http_connections", "Conexiones HTTP/WebSocket abiertas", NULL, gauge_connections, NULL);
+    metrics_gauge("api_long_poll_waiters", "Peticiones estacionadas con ?wait", NULL, gauge_waiters, NULL);
+    metrics_gauge("api_queue_depth", "Trabajos en cola (todas las clases), cacheado", NULL,
+        gauge_queue_depth, NULL);
+    metrics_gauge("api_result_cache_bytes", "Bytes en el cache de /result", NULL, gauge_cache_bytes, NULL);
+    metrics_gauge("api_pending_work_seconds", "Segundos-worker de trabajo pendiente al ritmo medido", NULL,
+        gauge_pending_work, NULL);
+    metrics_gauge("api_desired_workers", "Workers para terminar lo pendiente en SCALE_TARGET_SECONDS", NULL,
+        gauge_desired_workers, NULL);
+}
+
+static void rates_refresh(void) {
+    redisReply *reply = redis ? redis_client_command(redis, "HGETALL %s", RATES_KEY) : NULL;
+    if (reply && reply->type == REDIS_REPLY_ARRAY) {
+        for (size_t i = 0; i + 1 < reply->elements; i += 2) {
+            if (reply->element[i]->type != REDIS_REPLY_STRING ||
+                reply->element[i + 1]->type != REDIS_REPLY_STRING) continue;
+            int d = atoi(reply->element[i]->str);
+            if (d >= 0 && d <= 20) rates_cached[d] = atof(reply->element[i + 1]->str);
+        }
+    }
+    if (reply) freeReplyObject(reply);
+}
+
+// Trabajo pendiente = sum(primos pendientes por largo / primos/s de un worker
+// en ese largo); los workers necesarios son los que lo drenan en scale_target_s.
+static void scale_refresh(void) {
+    double primes[21];
+    scale_pending_primes = scale_pending_s = NAN;
+    scale_workers = -1;
+    uint64_t t0 = metrics_now_us();
+    int r = db_pending_primes(primes);
+    metrics_observe_us(m_db[DB_PENDING], metrics_now_us() - t0);
+    if (r != 0) return;
+    double total = 0, secs = 0;
+    for (int d = 0; d <= 20; ++d) {
+        if (primes[d] <= 0) continue;
+        double rate = rate_for(d);
+        if (rate <= 0) return;  // sin ninguna medicion todavia
+        total += primes[d];
+        secs += primes[d] / rate;
+    }
+    scale_pending_primes = total;
+    scale_pending_s = secs;
+    scale_workers = (long long)ceil(secs / scale_target_s);
+}
+
+// La profundidad de la cola, los ritmos de los workers y la senal de
+// autoscaling se calculan cada QUEUE_DEPTH_MS, no en cada scrape ni /status.
+static void queue_depth_timer(void *arg) {
+    (void)arg;
+    queue_depth_cached = queue_depth(redis);
+    rates_refresh();
+    scale_refresh();
+}
+
+static void trace_timer(void *arg) {
+    (void)arg;
+    trace_flush();
+}
+
+static int route_of(struct mg_http_message *hm) {
+    if (mg_match(hm->uri, mg_str("/"), NULL)) return ROUTE_HEALTH;
+    if (mg_match(hm->uri, mg_str("/ws"), NULL)) return ROUTE_WS;
+    if (mg_match(hm->uri, mg_str("/new"), NULL)) return ROUTE_NEW;
+    if (mg_match(hm->uri, mg_str("/metrics"), NULL)) return ROUTE_METRICS;
+    if (mg_match(hm->uri, mg_str("/scale"), NULL)) return ROUTE_SCALE;
+    if (mg_match(hm->uri, mg_str("/status/*"), NULL)) return ROUTE_STATUS;
+    if (mg_match(hm->uri, mg_str("/result/*"), NULL)) return ROUTE_RESULT;
+    return ROUTE_OTHER;
+}
+
+// Cuenta la peticion segun el codigo que el handler dejo en c->send a partir
+// de "sent"; los long-polls estacionados y las respuestas que esperan a Redis
+// asincrono no escribieron nada todavia.
+static void observe_request(struct mg_connection *c, int route, size_t sent, uint64_t t0) {
+    int k = 0;
+    if (c->send.len >= sent + 12 && memcmp(c->send.buf + sent, "HTTP/1.", 7) == 0) {
+        int d = c->send.buf[sent + 9] - '0';
+        if (d >= 1 && d < CODE_CLASSES) k = d;
+    }
+    metrics_inc(m_requests[route][k]);
+    metrics_observe_us(m_latency[route], metrics_now_us() - t0);
+}
+
 static void event_handler(struct mg_connection *c, int ev, void *ev_data) {
     if (ev == MG_EV_HTTP_MSG) {
         struct mg_http_message *hm = (struct mg_http_message *)ev_data;
+        uint64_t t0 = metrics_now_us();
+        size_t sent = c->send.len;
+        int route = route_of(hm);
         
-        if (mg_match(hm->uri, mg_str("/"), NULL)) {
-            mg_http_reply(c, 200, "Content-Type: application/json\r\n", "{\"status\":\"ok\"}");
+        if (route == ROUTE_HEALTH) {
+            handle_health(c);
+        } else if (route == ROUTE_METRICS) {
+            handle_metrics(c);
+        } else if (route == ROUTE_SCALE) {
+            handle_scale(c);
+        } else if (mg_match(hm->uri, mg_str("/ws"), NULL)) {
+            mg_ws_upgrade(c, hm, NULL);
         } else if (mg_match(hm->uri, mg_str("/new"), NULL)) {
             if (mg_match(hm->method, mg_str("POST"), NULL)) {
                 handle_new(c, hm);
@@ -183,56 +1267,130 @@ static void event_handler(struct mg_connection *c, int ev, void *ev_data) {
         } else {
             mg_http_reply(c, 404, "", "Not found\n");
         }
+        observe_request(c, route, sent, t0);
+    } else if (ev == MG_EV_WS_MSG) {
+        handle_ws_message(c, (struct mg_ws_message *)ev_data);
+    } else if (ev == MG_EV_WAKEUP) {
+        events_drain();
+    } else if (ev == MG_EV_CLOSE && c->is_websocket) {
+        ws_unsubscribe_conn(c);
+    } else if (ev == MG_EV_POLL && c->data[0] == STREAM_MARK) {
+        result_stream_step(c);
+    } else if (ev == MG_EV_CLOSE && c->data[0] == WAIT_MARK) {
+        waiters_remove_conn(c);
+    } else if (ev == MG_EV_CLOSE && c->data[0] == STREAM_MARK) {
+        struct result_stream *st;
+        memcpy(&st, c->data + 8, sizeof(st));
+        result_stream_free(st);
     }
 }
 
 static void sigint_handler(int signo) {
     (void)signo;
     keep_running = 0;
-    printf("[api] Shutting down...\n");
+    log_write(LOG_INFO, "[api] Shutting down...\n");
 }
 
-static redisContext *redis_init(void) {
-    const char *redis_host = getenv("REDIS_HOST");
+static struct redis_client *redis_init(void) {
+    const char *redis_host_s = getenv("REDIS_HOST");
     const char *redis_port_s = getenv("REDIS_PORT");
     
-    if (!redis_host) redis_host = "localhost";
-    if (!redis_port_s) redis_port_s = "6379";
-    
-    int redis_port = atoi(redis_port_s);
+    if (redis_host_s) redis_host = redis_host_s;
+    if (redis_port_s) redis_port = atoi(redis_port_s);
     
-    redisContext *c = redisConnect(redis_host, redis_port);
-    if (!c || c->err) {
-        fprintf(stderr, "[api] Redis connection failed: %s\n", 
-            c ? c->errstr : "Out of memory");
-        if (c) redisFree(c);
+    struct redis_client *rc = redis_client_open(redis_host, redis_port);
+    if (!rc || !redis_client_ctx(rc)) {
+        log_write(LOG_ERROR, "[api] Redis connection failed: %s:%d\n", redis_host, redis_port);
+        redis_client_close(rc);
         return NULL;
     }
-    printf("[api] Connected to Redis: %s:%d\n", redis_host, redis_port);
-    return c;
+    // Lo que aun va bloqueante en el hilo de Mongoose no puede quedarse
+    // esperando a un Redis colgado
+    const char *timeout_s = getenv("REDIS_TIMEOUT_MS");
+    redis_client_set_timeout(rc, timeout_s ? atoi(timeout_s) : DEFAULT_REDIS_TIMEOUT_MS);
+    log_write(LOG_INFO, "[api] Connected to Redis: %s:%d\n", redis_host, redis_port);
+    return rc;
+}
+
+// Una sola suscripcion Redis para todo el proceso; los eventos quedan en
+// events_pending, mg_wakeup() despierta al hilo de Mongoose y alli se
+// reparten a los clientes /ws.
+static void *events_thread(void *arg) {
+    (void)arg;
+    while (keep_running) {
+        redisContext *c = redisConnect(redis_host, redis_port);
+        if (!c || c->err) {
+            log_write(LOG_ERROR, "[api] Events: Redis connection failed: %s\n",
+                c ? c->errstr : "Out of memory");
+            if (c) redisFree(c);
+            sleep(1);
+            continue;
+        }
+        redisReply *reply = redisCommand(c, "SUBSCRIBE %s", EVENTS_CHANNEL);
+        if (reply) freeReplyObject(reply);
+        events_subscribed = reply != NULL;
+
+        while (keep_running && redisGetReply(c, (void **)&reply) == REDIS_OK) {
+            // Evento publicado por un worker: "<solicitud_id>:<generados>:<cantidad>"
+            char sid[40];
+            int generados, cantidad;
+            if (reply->type == REDIS_REPLY_ARRAY && reply->elements == 3 &&
+                reply->element[2]->type == REDIS_REPLY_STRING &&
+                sscanf(reply->element[2]->str, "%39[^:]:%d:%d", sid, &generados, &cantidad) == 3 &&
+                events_push(sid, generados, cantidad)) {
+                mg_wakeup(&mgr, listener_id, "e", 1);
+            }
+            freeReplyObject(reply);
+        }
+        events_subscribed = 0;
+        log_write(LOG_WARN, "[api] Events: subscription lost, reconnecting\n");
+        redisFree(c);
+        sleep(1);
+    }
+    return NULL;
 }
 
 int main(int argc, char **argv) {
     (void)argc; (void)argv;
+    log_init();
+    trace_init("primes-api");
     const char *env = getenv("DATABASE_URL");
     if (!env) {
-        fprintf(stderr, "[api] ERROR: Set DATABASE_URL env var\n");
+        log_write(LOG_ERROR, "[api] ERROR: Set DATABASE_URL env var\n");
         return 1;
     }
     db_url = env;
     if (db_init(db_url) != 0) {
-        fprintf(stderr, "[api] ERROR: Failed to initialize database\n");
+        log_write(LOG_ERROR, "[api] ERROR: Failed to initialize database\n");
         return 1;
     }
     
-    redis_ctx = redis_init();
-    if (!redis_ctx) {
-        fprintf(stderr, "[api] ERROR: Failed to initialize Redis\n");
+    queue_configure(getenv("QUEUE_BACKEND"));
+    log_write(LOG_INFO, "[api] Queue backend: %s\n", queue_backend_name());
+
+    // Con la cola en Postgres, Redis es opcional (cache de /status y /ws)
+    redis = redis_init();
+    if (!redis && queue_get_backend() != QUEUE_POSTGRES) {
+        log_write(LOG_ERROR, "[api] ERROR: Failed to initialize Redis\n");
         db_close();
         return 1;
     }
-    
-    db_set_redis(redis_ctx);
+
+    const char *verify = getenv("STATUS_CACHE_VERIFY");
+    if (verify) status_verify_every = atoi(verify);
+
+    const char *cache_bytes_s = getenv("RESULT_CACHE_BYTES");
+    cache_init(cache_bytes_s ? strtoul(cache_bytes_s, NULL, 10) : DEFAULT_RESULT_CACHE_BYTES);
+    metrics_setup();
+    if (redis) redis->latency_metric = m_redis;
+    const char *gzip_min_s = getenv("GZIP_MIN_BYTES");
+    if (gzip_min_s) gzip_min_bytes = strtoul(gzip_min_s, NULL, 10);
+    const char *gzip_level_s = getenv("GZIP_LEVEL");
+    if (gzip_level_s) gzip_level = atoi(gzip_level_s);
+    if (gzip_level < 1 || gzip_level > 9) gzip_level = DEFAULT_GZIP_LEVEL;
+    const char *scale_target_env = getenv("SCALE_TARGET_SECONDS");
+    if (scale_target_env) scale_target_s = atof(scale_target_env);
+    if (scale_target_s <= 0) scale_target_s = DEFAULT_SCALE_TARGET_SECONDS;
 
     signal(SIGINT, sigint_handler);
     signal(SIGTERM, sigint_handler);
@@ -241,14 +1399,59 @@ int main(int argc, char **argv) {
     const char *port = getenv("PORT") ? getenv("PORT") : DEFAULT_PORT;
     char listen_addr[64];
     snprintf(listen_addr, sizeof(listen_addr), "http://0.0.0.0:%s", port);
-    mg_http_listen(&mgr, listen_addr, event_handler, NULL);
-    printf("[api] Listening on %s\n", listen_addr);
+    struct mg_connection *lc = mg_http_listen(&mgr, listen_addr, event_handler, NULL);
+    if (!lc) {
+        log_write(LOG_ERROR, "[api] ERROR: Cannot listen on %s\n", listen_addr);
+        mg_mgr_free(&mgr);
+        db_close();
+        return 1;
+    }
+    listener_id = lc->id;
+    log_write(LOG_INFO, "[api] Listening on %s\n", listen_addr);
+
+    if (redis && redis_async_init(&mgr, redis_host, redis_port) != 0) {
+        log_write(LOG_WARN, "[api] WARNING: async Redis unavailable, status cache writes will block\n");
+    }
+
+    done_listener_start();
+    mg_timer_add(&mgr, 1000, MG_TIMER_REPEAT, wait_timer, NULL);
+    mg_timer_add(&mgr, QUEUE_DEPTH_MS, MG_TIMER_REPEAT | MG_TIMER_RUN_NOW, queue_depth_timer, NULL);
+    if (trace_enabled()) mg_timer_add(&mgr, 1000, MG_TIMER_REPEAT, trace_timer, NULL);
+
+    // El outbox solo existe para las colas de Redis
+    pthread_t outbox_tid;
+    int outbox_started = 0;
+    if (queue_get_backend() != QUEUE_POSTGRES) {
+        outbox_started = pthread_create(&outbox_tid, NULL, outbox_thread, NULL) == 0;
+        if (!outbox_started) log_write(LOG_WARN, "[api] WARNING: outbox relay not started\n");
+    }
+
+    pthread_t events_tid;
+    if (!redis || !mg_wakeup_init(&mgr) ||
+        pthread_create(&events_tid, NULL, events_thread, NULL) != 0) {
+        log_write(LOG_WARN, "[api] WARNING: /ws events disabled\n");
+    } else {
+        pthread_detach(events_tid);
+        mg_timer_add(&mgr, EVENTS_DRAIN_MS, MG_TIMER_REPEAT, events_timer, NULL);
+    }
 
     while (keep_running) mg_mgr_poll(&mgr, 1000);
     
+    if (outbox_started) {
+        outbox_kick();
+        pthread_join(outbox_tid, NULL);
+    }
+    redis_async_free();
+    done_listener_drop();
     mg_mgr_free(&mgr);
-    if (redis_ctx) redisFree(redis_ctx);
+    free(ws_subs);
+    free(events_pending);
+    free(waiters);
+    cache_free();
     db_close();
-    printf("[api] Shutdown complete\n");
+    redis_client_close(redis);
+    log_write(LOG_INFO, "[api] Shutdown complete\n");
+    trace_shutdown();
+    log_shutdown();
     return 0;
 }
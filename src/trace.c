@@ -0,0 +1,130 @@
+#define _POSIX_C_SOURCE 200809L
+#include "trace.h"
+#include "log.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TRACE_BATCH 256
+#define NAME_MAX_LEN 32
+#define MAX_ATTRS 4
+
+struct span {
+    char trace_id[TRACE_ID_LEN + 1];
+    char span_id[SPAN_ID_LEN + 1];
+    char parent_id[SPAN_ID_LEN + 1];
+    char name[NAME_MAX_LEN];
+    uint64_t start_ns, end_ns;
+    char attr_keys[MAX_ATTRS][NAME_MAX_LEN];
+    long long attr_values[MAX_ATTRS];
+    int n_attrs;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *out = NULL;
+static char service[64];
+static struct span batch[TRACE_BATCH];
+static int n_batch = 0;
+static unsigned long long span_seq = 0;
+
+void trace_init(const char *service_name) {
+    const char *path = getenv("TRACE_FILE");
+    snprintf(service, sizeof(service), "%s", service_name);
+    if (!path || !*path) return;
+    out = fopen(path, "a");
+    if (!out) log_write(LOG_ERROR, "[trace] Cannot open %s\n", path);
+}
+
+int trace_enabled(void) {
+    return out != NULL;
+}
+
+uint64_t trace_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void trace_id_from_uuid(const char *uuid, char *out_id) {
+    int n = 0;
+    for (const char *p = uuid; *p && n < TRACE_ID_LEN; ++p) {
+        if (*p == '-') continue;
+        if (!((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'f'))) break;
+        out_id[n++] = *p;
+    }
+    out_id[n == TRACE_ID_LEN ? n : 0] = '\0';
+}
+
+void trace_root_span_id(const char *trace_id, char *out_id) {
+    snprintf(out_id, SPAN_ID_LEN + 1, "%.16s", trace_id);
+}
+
+// Span ids unicos por proceso: pid, contador y reloj mezclados.
+void trace_new_span_id(char *out_id) {
+    uint64_t x = __atomic_add_fetch(&span_seq, 1, __ATOMIC_RELAXED);
+    x ^= trace_now_ns() * 0x9E3779B97F4A7C15ULL ^ ((uint64_t)getpid() << 40);
+    x ^= x >> 31;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 29;
+    snprintf(out_id, SPAN_ID_LEN + 1, "%016llx", (unsigned long long)x);
+}
+
+static void write_batch(void) {
+    if (!n_batch) return;
+    fprintf(out, "{\"resourceSpans\":[{\"resource\":{\"attributes\":[{\"key\":\"service.name\","
+        "\"value\":{\"stringValue\":\"%s\"}}]},\"scopeSpans\":[{\"scope\":{\"name\":\"primes\"},\"spans\":[",
+        service);
+    for (int i = 0; i < n_batch; ++i) {
+        const struct span *s = &batch[i];
+        fprintf(out, "%s{\"traceId\":\"%s\",\"spanId\":\"%s\",\"parentSpanId\":\"%s\",\"name\":\"%s\","
+            "\"kind\":1,\"startTimeUnixNano\":\"%llu\",\"endTimeUnixNano\":\"%llu\",\"attributes\":[",
+            i ? "," : "", s->trace_id, s->span_id, s->parent_id, s->name,
+            (unsigned long long)s->start_ns, (unsigned long long)s->end_ns);
+        for (int a = 0; a < s->n_attrs; ++a) {
+            fprintf(out, "%s{\"key\":\"%s\",\"value\":{\"intValue\":\"%lld\"}}", a ? "," : "",
+                s->attr_keys[a], s->attr_values[a]);
+        }
+        fputs("]}", out);
+    }
+    fputs("]}]}]}\n", out);
+    fflush(out);
+    n_batch = 0;
+}
+
+void trace_span(const char *trace_id, const char *span_id, const char *parent_id, const char *name,
+                uint64_t start_ns, uint64_t end_ns, const struct span_attr *attrs, int n_attrs) {
+    if (!out || !trace_id || strlen(trace_id) != TRACE_ID_LEN) return;
+    pthread_mutex_lock(&lock);
+    struct span *s = &batch[n_batch++];
+    snprintf(s->trace_id, sizeof(s->trace_id), "%s", trace_id);
+    if (span_id) snprintf(s->span_id, sizeof(s->span_id), "%s", span_id);
+    else trace_new_span_id(s->span_id);
+    snprintf(s->parent_id, sizeof(s->parent_id), "%s", parent_id ? parent_id : "");
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    s->start_ns = start_ns;
+    s->end_ns = end_ns;
+    s->n_attrs = n_attrs < MAX_ATTRS ? n_attrs : MAX_ATTRS;
+    for (int a = 0; a < s->n_attrs; ++a) {
+        snprintf(s->attr_keys[a], sizeof(s->attr_keys[a]), "%s", attrs[a].key);
+        s->attr_values[a] = attrs[a].value;
+    }
+    if (n_batch == TRACE_BATCH) write_batch();
+    pthread_mutex_unlock(&lock);
+}
+
+void trace_flush(void) {
+    if (!out) return;
+    pthread_mutex_lock(&lock);
+    write_batch();
+    pthread_mutex_unlock(&lock);
+}
+
+void trace_shutdown(void) {
+    if (!out) return;
+    trace_flush();
+    fclose(out);
+    out = NULL;
+}
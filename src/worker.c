@@ -4,97 +4,555 @@
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
+#include <pthread.h>
+#include <time.h>
 #include <hiredis/hiredis.h>
 #include "db.h"
 #include "prime.h"
+#include "queue.h"
+#include "redis_client.h"
+#include "metrics.h"
+#include "log.h"
+#include "trace.h"
+#include "mongoose.h"
 
 static volatile int keep_running = 1;
-static redisContext *redis_conn = NULL;
+static struct redis_client *redis_conn = NULL;
 static const char *db_url = NULL;
 static const char *redis_host = NULL;
 static int redis_port = 0;
 
+static char worker_id[128];
+
+#define DEFAULT_BATCH 4
+#define MAX_BATCH 32
+#define DEFAULT_PREFETCH 2
+#define MAX_PREFETCH 32
+#define DEFAULT_METRICS_PORT "9100"
+#define TRACE_BATCH_PRIMES 32   // primos por span "generate"
+#define RATE_SAMPLE_PRIMES 32   // primos entre mediciones del ritmo
+#define RATE_ALPHA 0.3
+
+// Buffer de prefetch: el hilo fetcher lo mantiene lleno (hasta PREFETCH jobs)
+// con su propia conexion Redis y es el unico que toca queue_* (el estado de
+// queue.c no es thread-safe); el hilo generador le devuelve los resultados
+// (ack o reencolado) por "outcomes".
+struct outcome {
+    struct job job;
+    int ack;
+    int remaining;
+};
+
+static struct job prefetched[MAX_PREFETCH];
+static int prefetch_head = 0, prefetch_count = 0, prefetch_cap = DEFAULT_PREFETCH;
+static struct outcome outcomes[2 * MAX_PREFETCH];
+static int n_outcomes = 0;
+static int generation_done = 0;
+static pthread_mutex_t buf_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t buf_not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t buf_changed = PTHREAD_COND_INITIALIZER;
+static struct redis_client *fetch_conn = NULL;
+static int batch = DEFAULT_BATCH;
+
+// Metricas del worker, servidas en METRICS_PORT por un hilo con su propio
+// mg_mgr. El generador acumula en variables locales y vuelca por primo
+// encontrado, no por candidato.
+enum job_result { JOB_COMPLETED, JOB_INTERRUPTED, JOB_ALREADY_DONE, JOB_FAILED, JOB_RESULTS };
+static const char *job_result_names[JOB_RESULTS] = { "completed", "interrupted", "already_done", "failed" };
+enum job_stage { STAGE_GENERATE, STAGE_DB, STAGE_REDIS, STAGES };
+static const char *stage_names[STAGES] = { "generate", "db", "redis" };
+static int m_candidates, m_prefilter_rejects, m_mr_tests, m_primes, m_duplicates, m_db_errors;
+static int m_jobs[JOB_RESULTS];
+static int m_stage[STAGES];
+static int m_job_duration;
+static int m_redis = -1;
+static struct mg_mgr metrics_mgr;
+
 static void sigint_handler(int signo) {
     (void)signo;
     keep_running = 0;
-    printf("[worker] Shutting down...\n");
+    log_write(LOG_INFO, "[worker] Shutting down...\n");
 }
 
-redisContext *redis_connect(const char *host, int port) {
-    redisContext *c = redisConnect(host, port);
-    if (c == NULL || c->err) {
-        fprintf(stderr, "[worker] Redis connection error: %s\n",
-            c ? c->errstr : "Out of memory");
-        if (c) redisFree(c);
-        return NULL;
+// Incrementa el contador cacheado y publica el progreso en un solo round trip.
+// Si el hash no coincide con Postgres (expirado, incrementos perdidos) se
+// reescribe completo con los valores de la base.
+void redis_publish_progress(struct redis_client *rc, const char *solicitud_id, int generados,
+                            int cantidad, int digitos) {
+    if (!rc) return;
+    char key[64];
+    snprintf(key, sizeof(key), STATUS_KEY_FMT, solicitud_id);
+    if (redis_client_append(rc, "HINCRBY %s generados 1", key) != 0 ||
+        redis_client_append(rc, "PUBLISH primes:events %s:%d:%d", solicitud_id, generados, cantidad) != 0) {
+        redis_client_discard(rc);
+        return;
+    }
+
+    long long cached = -1;
+    for (int i = 0; i < 2; ++i) {
+        redisReply *reply = redis_client_get_reply(rc);
+        if (!reply) {
+            log_write(LOG_WARN, "[worker] Redis error on progress update\n");
+            return;
+        }
+        if (i == 0 && reply->type == REDIS_REPLY_INTEGER) cached = reply->integer;
+        freeReplyObject(reply);
     }
-    return c;
+
+    if (cached != generados) {
+        redis_client_append(rc, "HSET %s cantidad %d digitos %d generados %d",
+            key, cantidad, digitos, generados);
+        redis_client_append(rc, "EXPIRE %s %d", key, STATUS_TTL_SECONDS);
+        redis_client_discard(rc);
+    }
+}
+
+// Ritmo de punta a punta (generacion + Postgres + Redis) por largo, suavizado
+// con EWMA y publicado en RATES_KEY para las estimaciones de /status.
+static double rate_ewma[21];
+
+static void observe_rate(int digitos, int primes, uint64_t elapsed_us) {
+    if (digitos < 0 || digitos > 20 || primes <= 0 || elapsed_us == 0) return;
+    double rate = primes * 1e6 / elapsed_us;
+    rate_ewma[digitos] = rate_ewma[digitos] > 0 ?
+        RATE_ALPHA * rate + (1 - RATE_ALPHA) * rate_ewma[digitos] : rate;
+    if (!redis_conn) return;
+    redis_client_append(redis_conn, "HSET %s %d %.3f", RATES_KEY, digitos, rate_ewma[digitos]);
+    redis_client_discard(redis_conn);
+}
+
+// Primos que realmente faltan segun Postgres; -1 si no se pudo consultar.
+static int remaining_for(const struct job *job) {
+    int cantidad, digitos, generados;
+    int r = db_get_status(job->solicitud_id, &cantidad, &digitos, &generados);
+    if (r == -2) return 0;
+    if (r != 0) return -1;
+    return generados < cantidad ? cantidad - generados : 0;
+}
+
+// Entrega al fetcher el resultado de un job. Espera si hay demasiados
+// pendientes, cosa que solo pasa si Redis no responde.
+static void post_outcome(const struct job *job, int ack, int remaining) {
+    pthread_mutex_lock(&buf_lock);
+    while (n_outcomes >= MAX_PREFETCH) pthread_cond_wait(&buf_changed, &buf_lock);
+    outcomes[n_outcomes].job = *job;
+    outcomes[n_outcomes].ack = ack;
+    outcomes[n_outcomes].remaining = remaining;
+    n_outcomes++;
+    pthread_cond_broadcast(&buf_changed);
+    pthread_mutex_unlock(&buf_lock);
+}
+
+// Contadores del generador acumulados localmente hasta el siguiente volcado.
+struct gen_counts {
+    uint64_t candidates, prefilter_rejects, mr_tests;
+};
+
+static void flush_counts(struct gen_counts *g) {
+    metrics_add(m_candidates, g->candidates);
+    metrics_add(m_prefilter_rejects, g->prefilter_rejects);
+    metrics_add(m_mr_tests, g->mr_tests);
+    memset(g, 0, sizeof(*g));
 }
 
-void redis_disconnect(redisContext *c) {
-    if (c) redisFree(c);
+static void finish_job(int result, uint64_t start_us, uint64_t db_us, uint64_t redis_us) {
+    uint64_t total = metrics_now_us() - start_us;
+    metrics_inc(m_jobs[result]);
+    metrics_observe_us(m_job_duration, total);
+    metrics_observe_us(m_stage[STAGE_DB], db_us);
+    metrics_observe_us(m_stage[STAGE_REDIS], redis_us);
+    metrics_observe_us(m_stage[STAGE_GENERATE], total > db_us + redis_us ? total - db_us - redis_us : 0);
 }
 
-int redis_get_job(redisContext *c, char *out_solicitud_id, int *out_cantidad, int *out_digitos) {
-    redisReply *reply = redisCommand(c, "BLPOP primes:queue 5");
-    if (!reply) {
-        fprintf(stderr, "[worker] Redis error on BLPOP\n");
-        return -1;
+// Spans del job: espera en cola y "job" cuelgan del span raiz que abrio la API;
+// conexion y un span "generate" por lote de primos cuelgan de "job".
+struct job_trace {
+    int on;
+    char root[SPAN_ID_LEN + 1], span[SPAN_ID_LEN + 1];
+    uint64_t start_ns, mark_ns;
+    int batch_found;     // primos al abrir el lote
+    uint64_t batch_io_us; // tiempo en Postgres + Redis al abrir el lote
+};
+
+static void job_trace_begin(struct job_trace *t, const struct job *job) {
+    t->on = trace_enabled() && job->trace_id[0];
+    if (!t->on) return;
+    t->start_ns = t->mark_ns = trace_now_ns();
+    t->batch_found = 0;
+    t->batch_io_us = 0;
+    trace_root_span_id(job->trace_id, t->root);
+    trace_new_span_id(t->span);
+    if (job->enqueued_ms > 0) {
+        struct span_attr attrs[] = { { "job.class", job->job_class } };
+        trace_span(job->trace_id, NULL, t->root, "queue.wait", (uint64_t)job->enqueued_ms * 1000000ULL,
+            t->start_ns, attrs, 1);
     }
+}
 
-    if (reply->type == REDIS_REPLY_NIL) {
-        freeReplyObject(reply);
-        return 1;
+// Cierra el tramo que empezo en la marca anterior y mueve la marca al final.
+static void job_trace_step(struct job_trace *t, const struct job *job, const char *name) {
+    if (!t->on) return;
+    uint64_t now = trace_now_ns();
+    trace_span(job->trace_id, NULL, t->span, name, t->mark_ns, now, NULL, 0);
+    t->mark_ns = now;
+}
+
+// Cierra el lote en curso: un span con los primos insertados y cuanto del
+// tramo se fue en Postgres y Redis, en vez de dos spans por primo.
+static void job_trace_batch(struct job_trace *t, const struct job *job, int found, uint64_t io_us) {
+    if (!t->on || found == t->batch_found) return;
+    uint64_t now = trace_now_ns();
+    struct span_attr attrs[] = {
+        { "primes", found - t->batch_found }, { "io_us", (long long)(io_us - t->batch_io_us) } };
+    trace_span(job->trace_id, NULL, t->span, "generate", t->mark_ns, now, attrs, 2);
+    t->mark_ns = now;
+    t->batch_found = found;
+    t->batch_io_us = io_us;
+}
+
+static void job_trace_end(struct job_trace *t, const struct job *job, int result, int found) {
+    if (!t->on) return;
+    struct span_attr attrs[] = { { "result", result }, { "found", found }, { "cantidad", job->cantidad } };
+    trace_span(job->trace_id, t->span, t->root, "job", t->start_ns, trace_now_ns(), attrs, 3);
+    trace_flush();
+}
+
+// Devuelve cuantos primos inserto.
+static int process_job(const struct job *job) {
+    uint64_t start_us = metrics_now_us();
+    struct job_trace tr;
+    job_trace_begin(&tr, job);
+    int cantidad, digitos, generados;
+    if (db_get_status(job->solicitud_id, &cantidad, &digitos, &generados) == 0 &&
+        generados >= cantidad) {
+        log_write(LOG_INFO, "[worker] Job already complete: solicitud_id=%s\n", job->solicitud_id);
+        post_outcome(job, 1, 0);
+        finish_job(JOB_ALREADY_DONE, start_us, metrics_now_us() - start_us, 0);
+        job_trace_end(&tr, job, JOB_ALREADY_DONE, 0);
+        return 0;
     }
 
-    if (reply->type != REDIS_REPLY_ARRAY || reply->elements < 2) {
-        fprintf(stderr, "[worker] Unexpected Redis response\n");
-        freeReplyObject(reply);
-        return -1;
+    PGconn *worker_conn = db_open_connection(db_url);
+    if (!worker_conn) {
+        log_write(LOG_ERROR, "[worker] Failed to open DB connection\n");
+        post_outcome(job, 0, -1);
+        finish_job(JOB_FAILED, start_us, metrics_now_us() - start_us, 0);
+        job_trace_end(&tr, job, JOB_FAILED, 0);
+        sleep(1);
+        return 0;
     }
 
-    const char *job_str = reply->element[1]->str;
-    
-    char solicitud_id[64], cantidad_str[32], digitos_str[32];
-    if (sscanf(job_str, "%63[^:]:%31[^:]:%31s", solicitud_id, cantidad_str, digitos_str) != 3) {
-        fprintf(stderr, "[worker] Failed to parse job: %s\n", job_str);
-        freeReplyObject(reply);
-        return -1;
+    job_trace_step(&tr, job, "db.connect");
+
+    int found = 0;
+    int done = 0;
+    struct gen_counts g = { 0 };
+    uint64_t db_us = metrics_now_us() - start_us, redis_us = 0;
+    tr.batch_io_us = db_us;
+    uint64_t rate_mark_us = metrics_now_us();
+    int rate_mark_found = 0;
+    while (found < job->cantidad && !done && keep_running) {
+        uint64_t cand = gen_random_of_digits(job->digitos);
+        int reached_mr;
+        g.candidates++;
+        if (!is_probable_prime_stage(cand, &reached_mr)) {
+            if (reached_mr) g.mr_tests++;
+            else g.prefilter_rejects++;
+            continue;
+        }
+        g.mr_tests += reached_mr;
+        flush_counts(&g);
+
+        char *s = u64_to_str(cand);
+        uint64_t t0 = metrics_now_us();
+        int ins = db_insert_result_conn(worker_conn, job->solicitud_id, s);
+
+        if (ins == 0) {
+            int total;
+            int inc = db_inc_generado_progress_conn(worker_conn, job->solicitud_id, &generados, &total);
+            uint64_t t1 = metrics_now_us();
+            db_us += t1 - t0;
+            if (inc == 0) {
+                redis_publish_progress(redis_conn, job->solicitud_id, generados, total, job->digitos);
+                uint64_t t2 = metrics_now_us();
+                redis_us += t2 - t1;
+                done = generados >= total;
+                if (done) db_notify_done_conn(worker_conn, job->solicitud_id);
+                db_us += metrics_now_us() - t2;
+            }
+            found++;
+            metrics_inc(m_primes);
+            if (found - rate_mark_found >= RATE_SAMPLE_PRIMES) {
+                uint64_t now = metrics_now_us();
+                observe_rate(job->digitos, found - rate_mark_found, now - rate_mark_us);
+                rate_mark_us = now;
+                rate_mark_found = found;
+            }
+            // Un evento por primo: muestreado para que el costo no crezca con el ritmo
+            if (log_sampled()) log_write(LOG_INFO, "[worker] Found: %s (%d/%d)\n", s, found, job->cantidad);
+        } else if (ins == -2) {
+            db_us += metrics_now_us() - t0;
+            metrics_inc(m_duplicates);
+        } else {
+            db_us += metrics_now_us() - t0;
+            metrics_inc(m_db_errors);
+            log_write(LOG_ERROR, "[worker] Error inserting result\n");
+        }
+        if (found - tr.batch_found >= TRACE_BATCH_PRIMES) job_trace_batch(&tr, job, found, db_us + redis_us);
+        free(s);
     }
+    job_trace_batch(&tr, job, found, db_us + redis_us);
+    flush_counts(&g);
+    observe_rate(job->digitos, found - rate_mark_found, metrics_now_us() - rate_mark_us);
 
-    strncpy(out_solicitud_id, solicitud_id, 63);
-    out_solicitud_id[63] = '\0';
-    *out_cantidad = atoi(cantidad_str);
-    *out_digitos = atoi(digitos_str);
+    db_close_connection(worker_conn);
+    if (found < job->cantidad && !done) {
+        uint64_t t0 = metrics_now_us();
+        post_outcome(job, 0, remaining_for(job));
+        db_us += metrics_now_us() - t0;
+        finish_job(JOB_INTERRUPTED, start_us, db_us, redis_us);
+        job_trace_end(&tr, job, JOB_INTERRUPTED, found);
+        log_write(LOG_INFO, "[worker] Job interrupted: solicitud_id=%s\n", job->solicitud_id);
+        return found;
+    }
+    post_outcome(job, 1, 0);
+    finish_job(JOB_COMPLETED, start_us, db_us, redis_us);
+    job_trace_end(&tr, job, JOB_COMPLETED, found);
+    log_write(LOG_INFO, "[worker] Job completed: solicitud_id=%s\n", job->solicitud_id);
+    return found;
+}
 
-    freeReplyObject(reply);
-    return 0;
+// Aplica en Redis los resultados pendientes del hilo generador. Si la conexion
+// cae a mitad, lo no aplicado vuelve a la lista para el siguiente intento.
+static void drain_outcomes(redisContext *c) {
+    struct outcome local[2 * MAX_PREFETCH];
+    pthread_mutex_lock(&buf_lock);
+    int n = n_outcomes;
+    memcpy(local, outcomes, (size_t)n * sizeof(local[0]));
+    n_outcomes = 0;
+    pthread_mutex_unlock(&buf_lock);
+
+    int i = 0;
+    for (; i < n; ++i) {
+        if (local[i].ack) queue_ack(c, &local[i].job);
+        else queue_requeue(c, &local[i].job, local[i].remaining);
+        if (c && c->err) break;
+    }
+
+    pthread_mutex_lock(&buf_lock);
+    if (i < n) {
+        memmove(&outcomes[n - i], outcomes, (size_t)n_outcomes * sizeof(outcomes[0]));
+        memcpy(outcomes, &local[i], (size_t)(n - i) * sizeof(outcomes[0]));
+        n_outcomes += n - i;
+    }
+    pthread_cond_broadcast(&buf_changed);
+    pthread_mutex_unlock(&buf_lock);
+}
+
+static void *fetcher_thread(void *arg) {
+    (void)arg;
+    while (keep_running) {
+        // Con el backend postgres la cola no usa Redis (fetch_conn es NULL)
+        redisContext *c = fetch_conn ? redis_client_ctx(fetch_conn) : NULL;
+        if (fetch_conn && !c) {
+            sleep(1);
+            continue;
+        }
+        drain_outcomes(c);
+        queue_heartbeat(c, 0);
+        queue_recover(c);
+
+        pthread_mutex_lock(&buf_lock);
+        int room = prefetch_cap - prefetch_count;
+        if (room <= 0) {
+            // Buffer lleno: despertar cuando el generador tome un job, entregue
+            // un resultado o cada segundo para el heartbeat.
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += 1;
+            pthread_cond_timedwait(&buf_changed, &buf_lock, &ts);
+            pthread_mutex_unlock(&buf_lock);
+            continue;
+        }
+        pthread_mutex_unlock(&buf_lock);
+
+        struct job jobs[MAX_PREFETCH];
+        int n = queue_fetch(c, jobs, room < batch ? room : batch);
+        if (n < 0) {
+            log_write(LOG_ERROR, "[worker] Failed to get job from Redis\n");
+            sleep(1);
+            continue;
+        }
+
+        pthread_mutex_lock(&buf_lock);
+        for (int i = 0; i < n; ++i) {
+            prefetched[(prefetch_head + prefetch_count) % MAX_PREFETCH] = jobs[i];
+            prefetch_count++;
+        }
+        if (n > 0) pthread_cond_signal(&buf_not_empty);
+        pthread_mutex_unlock(&buf_lock);
+    }
+
+    // Esperar a que el generador entregue el job en curso antes de devolver
+    // a la cola lo que quedo en el buffer.
+    pthread_mutex_lock(&buf_lock);
+    while (!generation_done) pthread_cond_wait(&buf_changed, &buf_lock);
+    pthread_mutex_unlock(&buf_lock);
+    redisContext *c = fetch_conn ? redis_client_ctx(fetch_conn) : NULL;
+    if (fetch_conn && !c) {
+        log_write(LOG_WARN, "[worker] Redis unavailable: pending jobs left for recovery\n");
+        return NULL;
+    }
+    drain_outcomes(c);
+    while (prefetch_count > 0) {
+        queue_requeue(c, &prefetched[prefetch_head], -1);
+        prefetch_head = (prefetch_head + 1) % MAX_PREFETCH;
+        prefetch_count--;
+    }
+    queue_worker_shutdown(c);
+    return NULL;
+}
+
+// Siguiente job del buffer; 0 si no hubo ninguno en un segundo.
+static int next_job(struct job *job) {
+    int got = 0;
+    pthread_mutex_lock(&buf_lock);
+    if (prefetch_count == 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += 1;
+        pthread_cond_timedwait(&buf_not_empty, &buf_lock, &ts);
+    }
+    if (prefetch_count > 0) {
+        *job = prefetched[prefetch_head];
+        prefetch_head = (prefetch_head + 1) % MAX_PREFETCH;
+        prefetch_count--;
+        got = 1;
+        pthread_cond_broadcast(&buf_changed);
+    }
+    pthread_mutex_unlock(&buf_lock);
+    return got;
+}
+
+static double gauge_prefetched(void *arg) {
+    (void)arg;
+    return (double)__atomic_load_n(&prefetch_count, __ATOMIC_RELAXED);
+}
+
+static void metrics_setup(void) {
+    m_candidates = metrics_counter("worker_candidates_total", "Candidatos generados", NULL);
+    m_prefilter_rejects = metrics_counter("worker_prefilter_rejects_total",
+        "Candidatos descartados por division entre primos chicos", NULL);
+    m_mr_tests = metrics_counter("worker_mr_tests_total", "Candidatos que llegaron a Miller-Rabin", NULL);
+    m_primes = metrics_counter("worker_primes_found_total", "Primos insertados", NULL);
+    m_duplicates = metrics_counter("worker_duplicates_total", "Primos rechazados por duplicados en la base", NULL);
+    m_db_errors = metrics_counter("worker_db_errors_total", "Errores al insertar resultados", NULL);
+    char labels[64];
+    for (int i = 0; i < JOB_RESULTS; ++i) {
+        snprintf(labels, sizeof(labels), "result=\"%s\"", job_result_names[i]);
+        m_jobs[i] = metrics_counter("worker_jobs_total", "Jobs procesados por resultado", labels);
+    }
+    for (int i = 0; i < STAGES; ++i) {
+        snprintf(labels, sizeof(labels), "stage=\"%s\"", stage_names[i]);
+        m_stage[i] = metrics_histogram("worker_job_stage_seconds",
+            "Tiempo por job en generacion, Postgres y Redis", labels);
+    }
+    m_job_duration = metrics_histogram("worker_job_duration_seconds", "Duracion total de cada job", NULL);
+    m_redis = metrics_histogram("worker_redis_call_duration_seconds",
+        "Latencia por round trip a Redis (progreso)", NULL);
+    metrics_gauge("worker_prefetched_jobs", "Jobs en el buffer de prefetch", NULL, gauge_prefetched, NULL);
+}
+
+static void metrics_handler(struct mg_connection *c, int ev, void *ev_data) {
+    if (ev != MG_EV_HTTP_MSG) return;
+    struct mg_http_message *hm = (struct mg_http_message *)ev_data;
+    if (!mg_match(hm->uri, mg_str("/metrics"), NULL)) {
+        mg_http_reply(c, 404, "", "Not found\n");
+        return;
+    }
+    char *text = NULL;
+    size_t len = metrics_render(&text);
+    mg_printf(c, "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: %lu\r\n\r\n", (unsigned long)len);
+    mg_send(c, text, len);
+    free(text);
+}
+
+static void *metrics_thread(void *arg) {
+    (void)arg;
+    while (keep_running) mg_mgr_poll(&metrics_mgr, 500);
+    mg_mgr_free(&metrics_mgr);
+    return NULL;
+}
+
+// METRICS_PORT=0 desactiva el endpoint.
+static int metrics_start(pthread_t *tid) {
+    const char *port = getenv("METRICS_PORT") ? getenv("METRICS_PORT") : DEFAULT_METRICS_PORT;
+    if (strcmp(port, "0") == 0) return 0;
+    char addr[64];
+    snprintf(addr, sizeof(addr), "http://0.0.0.0:%s", port);
+    mg_mgr_init(&metrics_mgr);
+    if (!mg_http_listen(&metrics_mgr, addr, metrics_handler, NULL) ||
+        pthread_create(tid, NULL, metrics_thread, NULL) != 0) {
+        log_write(LOG_WARN, "[worker] Metrics endpoint disabled (cannot listen on %s)\n", addr);
+        mg_mgr_free(&metrics_mgr);
+        return 0;
+    }
+    log_write(LOG_INFO, "[worker] Metrics on %s/metrics\n", addr);
+    return 1;
 }
 
 int main(int argc, char **argv) {
     (void)argc; (void)argv;
+    log_init();
+    trace_init("primes-worker");
+    metrics_setup();
 
     const char *db_env = getenv("DATABASE_URL");
     const char *redis_h = getenv("REDIS_HOST");
     const char *redis_p = getenv("REDIS_PORT");
 
-    if (!db_env || !redis_h || !redis_p) {
-        fprintf(stderr, "[worker] Missing env vars: DATABASE_URL, REDIS_HOST, REDIS_PORT\n");
+    // Con QUEUE_BACKEND=postgres Redis es opcional (solo progreso en vivo);
+    // con memory (modo benchmark hermetico) no se usa y la base por defecto
+    // tambien es la de memoria.
+    queue_configure(getenv("QUEUE_BACKEND"));
+    int hermetic = queue_get_backend() == QUEUE_MEMORY;
+    const char *db_backend = getenv("DB_BACKEND");
+    db_configure(db_backend ? db_backend : hermetic ? "memory" : "postgres");
+    int use_redis = !hermetic && (queue_get_backend() != QUEUE_POSTGRES || redis_h);
+    if ((!db_env && db_get_backend() != DB_MEMORY) || (use_redis && (!redis_h || !redis_p))) {
+        log_write(LOG_ERROR, "[worker] Missing env vars: DATABASE_URL, REDIS_HOST, REDIS_PORT\n");
         return 1;
     }
 
-    db_url = db_env;
-    redis_host = redis_h;
-    redis_port = atoi(redis_p);
+    db_url = db_env ? db_env : "memory";
+    redis_host = redis_h ? redis_h : "-";
+    redis_port = redis_p ? atoi(redis_p) : 0;
 
+    const char *id_env = getenv("WORKER_ID");
+    if (id_env) {
+        snprintf(worker_id, sizeof(worker_id), "%s", id_env);
+    } else {
+        char host[64];
+        if (gethostname(host, sizeof(host)) != 0) snprintf(host, sizeof(host), "worker");
+        host[sizeof(host) - 1] = '\0';
+        snprintf(worker_id, sizeof(worker_id), "%s-%d", host, (int)getpid());
+    }
     if (db_init(db_url) != 0) {
-        fprintf(stderr, "[worker] Failed to initialize database\n");
+        log_write(LOG_ERROR, "[worker] Failed to initialize database\n");
         return 1;
     }
 
-    redis_conn = redis_connect(redis_host, redis_port);
-    if (!redis_conn) {
-        fprintf(stderr, "[worker] Failed to connect to Redis\n");
+    if (use_redis) {
+        redis_conn = redis_client_open(redis_host, redis_port);
+        if (redis_conn) redis_conn->latency_metric = m_redis;
+        if (queue_get_backend() != QUEUE_POSTGRES) fetch_conn = redis_client_open(redis_host, redis_port);
+    }
+    if (use_redis && (!redis_conn || !redis_client_ctx(redis_conn) ||
+        (queue_get_backend() != QUEUE_POSTGRES && (!fetch_conn || !redis_client_ctx(fetch_conn))))) {
+        log_write(LOG_ERROR, "[worker] Failed to connect to Redis\n");
+        redis_client_close(fetch_conn);
+        redis_client_close(redis_conn);
         db_close();
         return 1;
     }
@@ -102,57 +560,86 @@ int main(int argc, char **argv) {
     signal(SIGINT, sigint_handler);
     signal(SIGTERM, sigint_handler);
 
-    printf("[worker] Started. DB: %s, Redis: %s:%d\n", db_url, redis_host, redis_port);
+    if (queue_worker_init(fetch_conn ? redis_client_ctx(fetch_conn) : NULL, worker_id, db_url,
+                          remaining_for) != 0) {
+        log_write(LOG_ERROR, "[worker] Failed to initialize %s queue\n", queue_backend_name());
+        redis_client_close(fetch_conn);
+        redis_client_close(redis_conn);
+        db_close();
+        return 1;
+    }
 
-    while (keep_running) {
-        char solicitud_id[64];
-        int cantidad, digitos;
+    const char *batch_env = getenv("QUEUE_BATCH");
+    batch = batch_env ? atoi(batch_env) : DEFAULT_BATCH;
+    if (batch < 1) batch = 1;
+    if (batch > MAX_BATCH) batch = MAX_BATCH;
 
-        int r = redis_get_job(redis_conn, solicitud_id, &cantidad, &digitos);
-        if (r == 1) {
-            continue;
-        } else if (r != 0) {
-            fprintf(stderr, "[worker] Failed to get job from Redis\n");
-            sleep(1);
-            continue;
-        }
+    const char *prefetch_env = getenv("PREFETCH");
+    prefetch_cap = prefetch_env ? atoi(prefetch_env) : DEFAULT_PREFETCH;
+    if (prefetch_cap < 1) prefetch_cap = 1;
+    if (prefetch_cap > MAX_PREFETCH) prefetch_cap = MAX_PREFETCH;
 
-        printf("[worker] Got job: solicitud_id=%s, cantidad=%d, digitos=%d\n",
-            solicitud_id, cantidad, digitos);
+    pthread_t fetcher;
+    if (pthread_create(&fetcher, NULL, fetcher_thread, NULL) != 0) {
+        log_write(LOG_ERROR, "[worker] Failed to start fetcher thread\n");
+        queue_worker_shutdown(fetch_conn ? redis_client_ctx(fetch_conn) : NULL);
+        redis_client_close(fetch_conn);
+        redis_client_close(redis_conn);
+        db_close();
+        return 1;
+    }
 
-        PGconn *worker_conn = db_open_connection(db_url);
-        if (!worker_conn) {
-            fprintf(stderr, "[worker] Failed to open DB connection\n");
-            sleep(1);
-            continue;
-        }
+    pthread_t metrics_tid;
+    int metrics_started = metrics_start(&metrics_tid);
 
-        int found = 0;
-        while (found < cantidad) {
-            uint64_t cand = gen_random_of_digits(digitos);
-            if (!is_probable_prime(cand)) continue;
-
-            char *s = u64_to_str(cand);
-            int ins = db_insert_result_conn(worker_conn, solicitud_id, s);
-
-            if (ins == 0) {
-                db_inc_generado_conn(worker_conn, solicitud_id);
-                found++;
-                printf("[worker] Found: %s (%d/%d)\n", s, found, cantidad);
-            } else if (ins == -2) {
-                continue;
-            } else {
-                fprintf(stderr, "[worker] Error inserting result\n");
-            }
-            free(s);
+    log_write(LOG_INFO, "[worker] Started %s (%s queue, prefetch %d). DB: %s, Redis: %s:%d\n",
+        worker_id, queue_backend_name(), prefetch_cap, db_url, redis_host, redis_port);
+
+    uint64_t bench_start = metrics_now_us(), bench_end = bench_start;
+    long long bench_jobs = 0, bench_primes = 0;
+    while (keep_running) {
+        struct job job;
+        if (!next_job(&job)) {
+            // Modo hermetico: la corrida termina cuando se consumio el ring
+            if (queue_drained()) break;
+            continue;
         }
 
-        db_close_connection(worker_conn);
-        printf("[worker] Job completed: solicitud_id=%s\n", solicitud_id);
+        log_write(LOG_INFO, "[worker] Got job: solicitud_id=%s, cantidad=%d, digitos=%d, class=%s\n",
+            job.solicitud_id, job.cantidad, job.digitos, queue_class_name(job.job_class));
+        if (redis_conn) queue_record_wait(redis_client_ctx(redis_conn), &job);
+        bench_primes += process_job(&job);
+        bench_jobs++;
+        bench_end = metrics_now_us();
+    }
+    keep_running = 0;
+    if (hermetic) {
+        double secs = (bench_end - bench_start) / 1e6;
+        log_write(LOG_INFO, "[worker] Bench: %lld jobs, %lld primes in %.3f s: %.2f jobs/s, %.0f primes/s\n",
+            bench_jobs, bench_primes, secs, secs > 0 ? bench_jobs / secs : 0.0,
+            secs > 0 ? bench_primes / secs : 0.0);
     }
 
-    printf("[worker] Shutting down gracefully...\n");
-    redis_disconnect(redis_conn);
+    log_write(LOG_INFO, "[worker] Shutting down gracefully...\n");
+    pthread_mutex_lock(&buf_lock);
+    generation_done = 1;
+    pthread_cond_broadcast(&buf_changed);
+    pthread_mutex_unlock(&buf_lock);
+    pthread_join(fetcher, NULL);
+    if (metrics_started) pthread_join(metrics_tid, NULL);
+
+    struct redis_stats st = { 0 };
+    if (redis_conn) redis_client_get_stats(redis_conn, &st);
+    if (use_redis) {
+        log_write(LOG_INFO, "[worker] Redis progress: %llu round trips, avg %llu us, max %llu us, %llu errors, %llu reconnects\n",
+            st.round_trips, st.round_trips ? st.total_us / st.round_trips : 0ULL, st.max_us,
+            st.errors, st.reconnects);
+    }
+    if (log_dropped()) log_write(LOG_WARN, "[worker] %llu log lines dropped\n", log_dropped());
+    redis_client_close(fetch_conn);
+    redis_client_close(redis_conn);
     db_close();
+    trace_shutdown();
+    log_shutdown();
     return 0;
 }